@@ -0,0 +1,170 @@
+
+#include "./Config.h"
+
+#include "./../Geometry/Matrix.h"
+#include "./../Geometry/Mesh.h"
+#include "./../Geometry/Vector.h"
+#include "./../Graphics/Canvas.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+
+// Renders african_head.obj triangle by triangle through every DrawFilledTriangle* entry point
+// and counts heap allocations made while drawing. Immediate rasterization must not allocate:
+// the process fails if any triangle does.
+
+namespace {
+
+
+std::atomic<std::size_t> g_allocations_count(0);
+
+
+} // namespace
+
+//-----------------------------------------------------------------------------
+// Replacement of the global allocation function: counts every allocation of the process
+void* operator new(std::size_t i_size)
+  {
+  ++g_allocations_count;
+  if(void* p_memory = std::malloc(i_size == 0 ? 1 : i_size))
+    return p_memory;
+  throw std::bad_alloc();
+  }
+
+//-----------------------------------------------------------------------------
+void operator delete(void* ip_memory) noexcept
+  {
+  std::free(ip_memory);
+  }
+
+//-----------------------------------------------------------------------------
+void operator delete(void* ip_memory, std::size_t) noexcept
+  {
+  std::free(ip_memory);
+  }
+
+//-----------------------------------------------------------------------------
+int main(int i_argc, char** i_argv)
+  {
+  using Canvas = Graphics::Canvas;
+  using ScreenPoint = Canvas::Point;
+  using TransformMatrix = Canvas::Transform;
+  using Vector4 = Geometry::Vector<float, 4>;
+
+  std::string source_dir = PROJECT_SOURCE_DIR;
+  auto input_filename = source_dir + "/_inputs/african_head.obj";
+  Canvas::Mesh const mesh(input_filename.c_str());
+  if(mesh.faces().empty())
+    {
+    std::cerr << "can't load " << input_filename << std::endl;
+    return 1;
+    }
+
+  int const width = 1024;
+  int const height = 1024;
+
+  TransformMatrix projection_matrix;
+  projection_matrix.MakeIdentity();
+  projection_matrix(3, 2) = -0.2f;
+
+  TransformMatrix viewport_matrix;
+  viewport_matrix.MakeIdentity();
+  viewport_matrix(0, 0) = width * 0.4f;
+  viewport_matrix(0, 3) = width * 0.5f;
+  viewport_matrix(1, 1) = height * 0.4f;
+  viewport_matrix(1, 3) = height * 0.5f;
+  viewport_matrix(2, 2) = height * 0.4f;
+  viewport_matrix(2, 3) = height * 0.5f;
+  TransformMatrix const transform = viewport_matrix * projection_matrix;
+
+  auto const to_screen = [&](Canvas::WorldPoint const& i_point)
+    {
+    Vector4 point = transform * Vector4(i_point[0], i_point[1], i_point[2], 1.f);
+    point /= point[3];
+    return ScreenPoint(static_cast<int>(point[0]), static_cast<int>(point[1]), static_cast<int>(point[2]));
+    };
+
+  Canvas::Image texture_image(256, 256, false);
+  for(DimensionType y = 0; y < texture_image.GetHeight(); ++y)
+    for(DimensionType x = 0; x < texture_image.GetWidth(); ++x)
+      {
+      Canvas::Color color;
+      color[0] = static_cast<Canvas::Color::ComponentType>(x);
+      color[1] = static_cast<Canvas::Color::ComponentType>(y);
+      color[2] = static_cast<Canvas::Color::ComponentType>(x ^ y);
+      texture_image.Set(x, y, color);
+      }
+
+  Canvas::Normal light_direction(0.f, -0.5f, 1.f);
+  light_direction.Normalise();
+
+  char const* const shading_names[] = {"flat", "texture", "gouraud", "phong", "gouraud texture", "phong texture"};
+  Canvas::Rasterizer const rasterizers[] = {Canvas::Rasterizer::Scanline, Canvas::Rasterizer::HalfSpace};
+  char const* const rasterizer_names[] = {"scanline", "half-space"};
+  bool is_allocation_free = true;
+  for(std::size_t r = 0; r < 2; ++r)
+    for(int shading = 0; shading < 6; ++shading)
+      {
+      Canvas canvas(width, height);
+      canvas.SetTextureImage(Canvas::Image(texture_image));
+      canvas.SetLightDirection(light_direction);
+      canvas.SetRasterizer(rasterizers[r]);
+
+      std::size_t const allocations_before = g_allocations_count;
+      auto const t1 = std::chrono::high_resolution_clock::now();
+      for(auto const& face : mesh.faces())
+        {
+        auto const& vertex_indices = std::get<0>(face);
+        auto const& texture_indices = std::get<1>(face);
+        auto const& normal_indices = std::get<2>(face);
+        ScreenPoint const pt1 = to_screen(mesh.vertex(vertex_indices[0]));
+        ScreenPoint const pt2 = to_screen(mesh.vertex(vertex_indices[1]));
+        ScreenPoint const pt3 = to_screen(mesh.vertex(vertex_indices[2]));
+        auto const& tx1 = mesh.texture(texture_indices[0]);
+        auto const& tx2 = mesh.texture(texture_indices[1]);
+        auto const& tx3 = mesh.texture(texture_indices[2]);
+        auto const& n1 = mesh.normal(normal_indices[0]);
+        auto const& n2 = mesh.normal(normal_indices[1]);
+        auto const& n3 = mesh.normal(normal_indices[2]);
+        switch(shading)
+          {
+          case 0:
+            {
+            Canvas::Color color;
+            color.Fill(200);
+            canvas.DrawFilledTriangle(pt1, pt2, pt3, color);
+            break;
+            }
+          case 1:
+            canvas.DrawFilledTriangle(pt1, pt2, pt3, tx1, tx2, tx3, 1.f);
+            break;
+          case 2:
+            canvas.DrawFilledTriangleGouraud(pt1, pt2, pt3, n1, n2, n3);
+            break;
+          case 3:
+            canvas.DrawFilledTrianglePhong(pt1, pt2, pt3, n1, n2, n3);
+            break;
+          case 4:
+            canvas.DrawFilledTriangleGouraud(pt1, pt2, pt3, tx1, tx2, tx3, n1, n2, n3);
+            break;
+          default:
+            canvas.DrawFilledTrianglePhong(pt1, pt2, pt3, tx1, tx2, tx3, n1, n2, n3);
+            break;
+          }
+        }
+      auto const t2 = std::chrono::high_resolution_clock::now();
+      std::size_t const allocations_count = g_allocations_count - allocations_before;
+
+      std::cout << rasterizer_names[r] << ", " << shading_names[shading] << ": "
+                << static_cast<double>(allocations_count) / mesh.faces().size() << " allocations per triangle, "
+                << std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count() << " us" << std::endl;
+      if(allocations_count != 0)
+        is_allocation_free = false;
+      }
+
+  return is_allocation_free ? 0 : 1;
+  }
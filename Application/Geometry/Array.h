@@ -5,6 +5,7 @@
 #include "./../Global/TupleExtends.h"
 
 #include <array>
+#include <type_traits>
 
 
 namespace Geometry {
@@ -31,26 +32,26 @@ struct Array
   using Data = std::array<ValueType, Dimension>;
 
   // Lifetime
-  Array();
-  template<typename ... TArgs>
-  Array(TArgs&& ... i_args); // N args constructor
-  template<typename TSelf>
-  Array(TSelf&& i_rhs); // Copy - Move constructor
+  // Copy and move are implicit, so the type stays trivially copyable (memcpy-able, vectorizable)
+  Array() = default; // elements are left uninitialized, as for built-in arrays
+  constexpr explicit Array(Data const& i_data);
+  template<typename ... TArgs, typename = std::enable_if_t<sizeof...(TArgs) == NDimension>>
+  constexpr Array(TArgs const& ... i_args); // N args constructor
 
   // CompileTime safe element access via Axis class
   template<DimensionType N>
-  Reference Get();
+  constexpr Reference Get();
   template<DimensionType N>
-  ConstReference Get() const;
+  constexpr ConstReference Get() const;
   template<DimensionType N>
-  void Set(ConstReference i_value);
+  constexpr void Set(ConstReference i_value);
   
   // Runtime non-safe element access via index
-  Reference operator[](SizeType i_index);
-  ConstReference operator[](SizeType i_index) const;
+  constexpr Reference operator[](SizeType i_index);
+  constexpr ConstReference operator[](SizeType i_index) const;
 
-  Data& GetData();
-  Data const& GetData() const;
+  constexpr Data& GetData();
+  constexpr Data const& GetData() const;
 
   template<DimensionType NDirection = Dimension>
   Array<TValueType, NDimension + 1> Extend(ValueType const& i_value) const;
@@ -61,17 +62,11 @@ struct Array
 
   protected:
     template<DimensionType N>
-    static void _DimensionCheckEqual();
+    static constexpr void _DimensionCheckEqual();
     template<DimensionType N>
-    static void _DimensionCheckLess();
+    static constexpr void _DimensionCheckLess();
 
   private:
-    template<DimensionType N, typename T, typename ... TArgs>
-    void _Init(T const& value, TArgs&& ... i_args);
-
-    template<DimensionType N>
-    void _Init();
-
     Data m_data;
   };
 
@@ -80,31 +75,25 @@ struct Array
 // Array // struct definition //
 ///////////////////////////////////////////////////////////////////////////////
 template<typename TValueType, DimensionType NDimension>
-Array<TValueType, NDimension>::Array()
-  {
-  }
-
-//-----------------------------------------------------------------------------
-template<typename TValueType, DimensionType NDimension>
-template<typename ... TArgs>
-Array<TValueType, NDimension>::Array(TArgs&& ... i_args)
+constexpr
+Array<TValueType, NDimension>::Array(Data const& i_data)
+  : m_data(i_data)
   {
-  _DimensionCheckEqual<sizeof...(TArgs)>();
-  _Init<0>(std::forward<TArgs>(i_args)...);
   }
 
 //-----------------------------------------------------------------------------
 template<typename TValueType, DimensionType NDimension>
-template<typename TSelf>
-Array<TValueType, NDimension>::Array(TSelf&& i_rhs)
-  : m_data(i_rhs.m_data)
+template<typename ... TArgs, typename>
+constexpr
+Array<TValueType, NDimension>::Array(TArgs const& ... i_args)
+  : m_data{{static_cast<ValueType>(i_args)...}}
   {
   }
 
 //-----------------------------------------------------------------------------
 template<typename TValueType, DimensionType NDimension>
 template<DimensionType N>
-typename Array<TValueType, NDimension>::Reference
+constexpr typename Array<TValueType, NDimension>::Reference
 Array<TValueType, NDimension>::Get()
   {
   return const_cast<Reference>(const_cast<Self const*>(this)->Get<N>());
@@ -113,7 +102,7 @@ Array<TValueType, NDimension>::Get()
 //-----------------------------------------------------------------------------
 template<typename TValueType, DimensionType NDimension>
 template<DimensionType N>
-typename Array<TValueType, NDimension>::ConstReference
+constexpr typename Array<TValueType, NDimension>::ConstReference
 Array<TValueType, NDimension>::Get() const
   {
   _DimensionCheckLess<N>();
@@ -123,7 +112,7 @@ Array<TValueType, NDimension>::Get() const
 //-----------------------------------------------------------------------------
 template<typename TValueType, DimensionType NDimension>
 template<DimensionType N>
-void
+constexpr void
 Array<TValueType, NDimension>::Set(ConstReference i_value)
   {
   _DimensionCheckLess<N>();
@@ -132,7 +121,7 @@ Array<TValueType, NDimension>::Set(ConstReference i_value)
 
 //-----------------------------------------------------------------------------
 template<typename TValueType, DimensionType NDimension>
-typename Array<TValueType, NDimension>::Reference
+constexpr typename Array<TValueType, NDimension>::Reference
 Array<TValueType, NDimension>::operator[](SizeType i_index)
   {
   return const_cast<Reference>(const_cast<Self const*>(this)->operator[](i_index));
@@ -140,7 +129,7 @@ Array<TValueType, NDimension>::operator[](SizeType i_index)
 
 //-----------------------------------------------------------------------------
 template<typename TValueType, DimensionType NDimension>
-typename Array<TValueType, NDimension>::ConstReference
+constexpr typename Array<TValueType, NDimension>::ConstReference
 Array<TValueType, NDimension>::operator[](SizeType i_index) const
   {
   return m_data[i_index];
@@ -148,7 +137,7 @@ Array<TValueType, NDimension>::operator[](SizeType i_index) const
 
 //-----------------------------------------------------------------------------
 template<typename TValueType, DimensionType NDimension>
-typename Array<TValueType, NDimension>::Data&
+constexpr typename Array<TValueType, NDimension>::Data&
 Array<TValueType, NDimension>::GetData()
   {
   return const_cast<Data&>(const_cast<Self const*>(this)->GetData());
@@ -156,7 +145,7 @@ Array<TValueType, NDimension>::GetData()
 
 //-----------------------------------------------------------------------------
 template<typename TValueType, DimensionType NDimension>
-typename Array<TValueType, NDimension>::Data const&
+constexpr typename Array<TValueType, NDimension>::Data const&
 Array<TValueType, NDimension>::GetData() const
   {
   return m_data;
@@ -197,7 +186,7 @@ Array<TValueType, NDimension>::operator!=(Array const& i_rhs) const
 //-----------------------------------------------------------------------------
 template<typename TValueType, DimensionType NDimension>
 template<DimensionType N>
-void
+constexpr void
 Array<TValueType, NDimension>::_DimensionCheckEqual()
   {
   static_assert(N == Dimension, "Wrong Dimension!");
@@ -206,30 +195,15 @@ Array<TValueType, NDimension>::_DimensionCheckEqual()
 //-----------------------------------------------------------------------------
 template<typename TValueType, DimensionType NDimension>
 template<DimensionType N>
-void
+constexpr void
 Array<TValueType, NDimension>::_DimensionCheckLess()
   {
   static_assert(N < Dimension, "Wrong Dimension!");
   }
 
-//-----------------------------------------------------------------------------
-template<typename TValueType, DimensionType NDimension>
-template<DimensionType N, typename T, typename ... TArgs>
-void Array<TValueType, NDimension>::_Init(T const& value, TArgs&&... i_args)
-  {
-  static_assert(N < Dimension, "Wrong Dimension!");
 
-  _Init<N + 1>(std::forward<TArgs>(i_args)...);
-  operator[](N) = value;
-  }
-
-//-----------------------------------------------------------------------------
-template<typename TValueType, DimensionType NDimension>
-template<DimensionType N>
-void Array<TValueType, NDimension>::_Init()
-  {
-  _DimensionCheckEqual<N>();
-  }
+static_assert(std::is_trivially_copyable<Array<float, 3>>::value, "Array is expected to be trivially copyable");
+static_assert(std::is_standard_layout<Array<float, 3>>::value, "Array is expected to be layout compatible with ValueType[N]");
 
 
 } // namespace Geometry
@@ -0,0 +1,204 @@
+
+#pragma once
+
+#include "./Matrix.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define BATCH_TRANSFORM_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BATCH_TRANSFORM_SSE2
+#endif
+
+
+namespace Geometry {
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ViewportMapping // struct declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Applied after the homogeneous divide: p' = p * scale + offset, per axis
+struct ViewportMapping
+  {
+  float m_scale[3];
+  float m_offset[3];
+
+  static ViewportMapping GetIdentity();
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// BatchTransform // struct declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Transforms arrays of 3D points (w == 1) by a 4x4 matrix, multiplies them by 1 / w
+// (as Matrix * Vector callers do, so results match theirs bit for bit) and maps
+// them to the viewport. Four (SSE2) or eight (AVX) points are processed at once,
+// the rest is done by scalar code computing exactly the same expressions.
+// Output w is the one before the divide; points with w <= 0 are behind the camera
+// and their coordinates are meaningless.
+struct BatchTransform
+  {
+  using Transform = Matrix<float, 4, 4>;
+
+  BatchTransform(Transform const& i_transform, ViewportMapping const& i_viewport = ViewportMapping::GetIdentity());
+
+  // SoA: coordinates in separate arrays, outputs may alias inputs
+  void TransformSoA(float const* ip_x, float const* ip_y, float const* ip_z, std::size_t i_count,
+                    float* op_x, float* op_y, float* op_z, float* op_w) const;
+
+  // AoS: i_count points, x y z of each are contiguous and points are i_stride floats apart
+  // (3 for packed Point<float, 3>). Output is packed x y z, w goes to its own array.
+  void TransformAoS(float const* ip_points, std::size_t i_stride, std::size_t i_count,
+                    float* op_points, float* op_w) const;
+
+  private:
+    static constexpr std::size_t _AoSBlockSize = 64;
+
+    void _TransformScalar(float i_x, float i_y, float i_z, float& o_x, float& o_y, float& o_z, float& o_w) const;
+
+    float m_matrix[4][4];
+    ViewportMapping m_viewport;
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ViewportMapping // struct definition //
+///////////////////////////////////////////////////////////////////////////////
+inline ViewportMapping
+ViewportMapping::GetIdentity()
+  {
+  ViewportMapping viewport;
+  for(int i = 0; i < 3; ++i)
+    {
+    viewport.m_scale[i] = 1.f;
+    viewport.m_offset[i] = 0.f;
+    }
+  return viewport;
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// BatchTransform // struct definition //
+///////////////////////////////////////////////////////////////////////////////
+inline
+BatchTransform::BatchTransform(Transform const& i_transform, ViewportMapping const& i_viewport)
+  : m_viewport(i_viewport)
+  {
+  for(DimensionType row = 0; row < 4; ++row)
+    for(DimensionType column = 0; column < 4; ++column)
+      m_matrix[row][column] = i_transform(row, column);
+  }
+
+//-----------------------------------------------------------------------------
+inline void
+BatchTransform::_TransformScalar(float i_x, float i_y, float i_z, float& o_x, float& o_y, float& o_z, float& o_w) const
+  {
+  float transformed[4];
+  for(int row = 0; row < 4; ++row)
+    transformed[row] = m_matrix[row][0] * i_x + m_matrix[row][1] * i_y + m_matrix[row][2] * i_z + m_matrix[row][3];
+  o_w = transformed[3];
+  float const inversed_w = 1.f / transformed[3];
+  o_x = transformed[0] * inversed_w * m_viewport.m_scale[0] + m_viewport.m_offset[0];
+  o_y = transformed[1] * inversed_w * m_viewport.m_scale[1] + m_viewport.m_offset[1];
+  o_z = transformed[2] * inversed_w * m_viewport.m_scale[2] + m_viewport.m_offset[2];
+  }
+
+//-----------------------------------------------------------------------------
+inline void
+BatchTransform::TransformSoA(float const* ip_x, float const* ip_y, float const* ip_z, std::size_t i_count,
+                             float* op_x, float* op_y, float* op_z, float* op_w) const
+  {
+  std::size_t i = 0;
+
+#if defined(BATCH_TRANSFORM_AVX) || defined(BATCH_TRANSFORM_SSE2)
+#if defined(BATCH_TRANSFORM_AVX)
+  using Register = __m256;
+  std::size_t const lanes = 8;
+  auto const load = [](float const* ip) { return _mm256_loadu_ps(ip); };
+  auto const store = [](float* op, Register i_value) { _mm256_storeu_ps(op, i_value); };
+  auto const broadcast = [](float i_value) { return _mm256_set1_ps(i_value); };
+  auto const add = [](Register i_a, Register i_b) { return _mm256_add_ps(i_a, i_b); };
+  auto const mul = [](Register i_a, Register i_b) { return _mm256_mul_ps(i_a, i_b); };
+  auto const div = [](Register i_a, Register i_b) { return _mm256_div_ps(i_a, i_b); };
+#else
+  using Register = __m128;
+  std::size_t const lanes = 4;
+  auto const load = [](float const* ip) { return _mm_loadu_ps(ip); };
+  auto const store = [](float* op, Register i_value) { _mm_storeu_ps(op, i_value); };
+  auto const broadcast = [](float i_value) { return _mm_set1_ps(i_value); };
+  auto const add = [](Register i_a, Register i_b) { return _mm_add_ps(i_a, i_b); };
+  auto const mul = [](Register i_a, Register i_b) { return _mm_mul_ps(i_a, i_b); };
+  auto const div = [](Register i_a, Register i_b) { return _mm_div_ps(i_a, i_b); };
+#endif
+
+  Register matrix[4][4];
+  for(int row = 0; row < 4; ++row)
+    for(int column = 0; column < 4; ++column)
+      matrix[row][column] = broadcast(m_matrix[row][column]);
+  Register const one = broadcast(1.f);
+  Register scale[3];
+  Register offset[3];
+  for(int axis = 0; axis < 3; ++axis)
+    {
+    scale[axis] = broadcast(m_viewport.m_scale[axis]);
+    offset[axis] = broadcast(m_viewport.m_offset[axis]);
+    }
+
+  for(; i + lanes <= i_count; i += lanes)
+    {
+    Register const x = load(ip_x + i);
+    Register const y = load(ip_y + i);
+    Register const z = load(ip_z + i);
+    Register transformed[4];
+    for(int row = 0; row < 4; ++row)
+      transformed[row] = add(add(add(mul(matrix[row][0], x), mul(matrix[row][1], y)), mul(matrix[row][2], z)), matrix[row][3]);
+    store(op_w + i, transformed[3]);
+    Register const inversed_w = div(one, transformed[3]);
+    store(op_x + i, add(mul(mul(transformed[0], inversed_w), scale[0]), offset[0]));
+    store(op_y + i, add(mul(mul(transformed[1], inversed_w), scale[1]), offset[1]));
+    store(op_z + i, add(mul(mul(transformed[2], inversed_w), scale[2]), offset[2]));
+    }
+#endif
+
+  for(; i < i_count; ++i)
+    _TransformScalar(ip_x[i], ip_y[i], ip_z[i], op_x[i], op_y[i], op_z[i], op_w[i]);
+  }
+
+//-----------------------------------------------------------------------------
+inline void
+BatchTransform::TransformAoS(float const* ip_points, std::size_t i_stride, std::size_t i_count,
+                             float* op_points, float* op_w) const
+  {
+  // Deinterleave small blocks on the stack, so the SoA kernel does all the math
+  float x[_AoSBlockSize];
+  float y[_AoSBlockSize];
+  float z[_AoSBlockSize];
+  for(std::size_t block = 0; block < i_count; block += _AoSBlockSize)
+    {
+    std::size_t const count = std::min(_AoSBlockSize, i_count - block);
+    float const* p_point = ip_points + block * i_stride;
+    for(std::size_t i = 0; i < count; ++i, p_point += i_stride)
+      {
+      x[i] = p_point[0];
+      y[i] = p_point[1];
+      z[i] = p_point[2];
+      }
+
+    TransformSoA(x, y, z, count, x, y, z, op_w + block);
+
+    float* p_output = op_points + block * 3;
+    for(std::size_t i = 0; i < count; ++i, p_output += 3)
+      {
+      p_output[0] = x[i];
+      p_output[1] = y[i];
+      p_output[2] = z[i];
+      }
+    }
+  }
+
+
+} // namespace Geometry
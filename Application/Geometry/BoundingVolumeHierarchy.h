@@ -0,0 +1,763 @@
+
+#pragma once
+
+#include "./HomogeneousCrossProduct.h"
+#include "./Matrix.h"
+#include "./Mesh.h"
+#include "../Global/ParallelFor.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+
+namespace Geometry {
+
+
+///////////////////////////////////////////////////////////////////////////////
+// BoundingVolumeHierarchy // class declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Bounding box tree over the faces of a mesh for ray and frustum queries.
+// Built top-down with the binned surface area heuristic; the top levels are
+// split serially until there are enough subtrees for all threads, which are
+// then built in parallel. Nodes are stored depth-first in one array: the left
+// child of an inner node is the next node, so half of the descents are a step
+// to the neighbouring 32 bytes. Leaves own a contiguous range of triangles
+// stored in the same order, with the face index of the source mesh.
+class BoundingVolumeHierarchy
+  {
+  public:
+    using Transform = Matrix<float, 4, 4>;
+
+    struct alignas(32) Node
+      {
+      float m_min[3];
+      std::uint32_t m_first; // leaf: first triangle, inner: right child node
+      float m_max[3];
+      std::uint32_t m_count; // leaf: triangles count, inner: 0
+      };
+
+    struct Ray
+      {
+      float m_origin[3];
+      float m_direction[3];
+      float m_min_distance; // in units of m_direction
+      float m_max_distance;
+      };
+
+    struct Hit
+      {
+      std::size_t m_face;
+      float m_distance; // in units of m_direction
+      float m_u;        // barycentric coordinates of the second and the third corners
+      float m_v;
+      };
+
+    // Points p with dot(m_normal, p) + m_offset >= 0 are inside
+    struct Plane
+      {
+      float m_normal[3];
+      float m_offset;
+      };
+    using Frustum = std::array<Plane, 5>;
+
+    BoundingVolumeHierarchy();
+    template<typename TMesh>
+    explicit BoundingVolumeHierarchy(TMesh const& i_mesh, std::size_t i_threads_count = 0); // Mesh, MappedMesh
+
+    std::vector<Node> const& nodes() const;
+    std::size_t GetFacesCount() const;
+
+    // Closest face hit within [m_min_distance, m_max_distance], counter-clockwise or not
+    bool Intersect(Ray const& i_ray, Hit& o_hit) const;
+    // Calls i_visitor(face) for every face whose bounding box may be seen through
+    // the frustum, in tree order; whole subtrees inside it are reported without tests.
+    template<typename F>
+    void QueryFrustum(Frustum const& i_frustum, F i_visitor) const;
+
+    // Visible volume of a world -> screen transform (the one of Canvas::DrawMesh):
+    // in front of the camera and projected to [0, width] x [0, height]
+    static Frustum GetFrustum(Transform const& i_transform, int i_width, int i_height);
+    // Points projected to screen pixel (x, y), from the camera away from the
+    // viewer (decreasing screen z); a parallel projection gives an unbounded line
+    static Ray GetScreenRay(Transform const& i_transform, float i_x, float i_y);
+
+  private:
+    struct _Bounds
+      {
+      float m_min[3];
+      float m_max[3];
+
+      void Reset();
+      void Extend(_Bounds const& i_bounds);
+      void Extend(float const (&i_point)[3]);
+      float GetHalfArea() const;
+      };
+
+    struct _Triangle
+      {
+      float m_origin[3];
+      float m_edge1[3];
+      float m_edge2[3];
+      };
+
+    // Node of a tree being built: tree 0 is the serial top, others are parallel subtrees
+    struct _Reference
+      {
+      std::uint32_t m_tree;
+      std::uint32_t m_node;
+      };
+    struct _BuildNode
+      {
+      _Bounds m_bounds;
+      std::uint32_t m_begin; // range of m_faces
+      std::uint32_t m_end;
+      std::uint32_t m_depth;
+      bool m_is_leaf;
+      _Reference m_children[2];
+      };
+
+    static constexpr std::size_t _BinsCount = 16;
+    static constexpr std::size_t _MaxLeafSize = 8;
+    static constexpr std::size_t _MinParallelSize = 1 << 12;
+    static constexpr std::size_t _MaxDepth = 64; // deeper nodes become leaves, bounds traversal stacks
+
+    // Face bounds of Mesh::PrecomputeFaceData(), false for meshes without them
+    template<typename TMesh>
+    static bool _GetPrecomputedBounds(TMesh const& i_mesh, std::size_t i_face, _Bounds& o_bounds);
+    template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
+    static bool _GetPrecomputedBounds(Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType> const& i_mesh,
+                                      std::size_t i_face, _Bounds& o_bounds);
+
+    // Partitions m_faces[i_begin, i_end) by the cheapest split, returns false to make a leaf
+    bool _Split(std::uint32_t i_begin, std::uint32_t i_end, std::uint32_t i_depth, std::uint32_t& o_middle);
+    _Bounds _GetBounds(std::uint32_t i_begin, std::uint32_t i_end) const;
+    void _BuildSubtree(std::uint32_t i_begin, std::uint32_t i_end, std::uint32_t i_depth, std::uint32_t i_tree,
+                       std::vector<_BuildNode>& io_nodes);
+    void _Flatten(std::vector<std::vector<_BuildNode>> const& i_trees, _Reference const& i_root);
+
+    static bool _IntersectBounds(Node const& i_node, float const (&i_origin)[3], float const (&i_inverse_direction)[3],
+                                 float i_min_distance, float i_max_distance, float& o_distance);
+
+    std::vector<Node> m_nodes;
+    std::vector<_Triangle> m_triangles; // in leaf order
+    std::vector<std::uint32_t> m_faces; // source face of every triangle
+
+    // Build only
+    std::vector<_Bounds> m_face_bounds;
+    std::vector<std::array<float, 3>> m_centroids;
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// BoundingVolumeHierarchy // class definition //
+///////////////////////////////////////////////////////////////////////////////
+inline
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+  {
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TMesh>
+BoundingVolumeHierarchy::BoundingVolumeHierarchy(TMesh const& i_mesh, std::size_t i_threads_count)
+  {
+  auto const& faces = i_mesh.faces();
+  auto const& vertices = i_mesh.vertices();
+  std::size_t const faces_count = faces.size();
+  assert(faces_count < std::numeric_limits<std::uint32_t>::max());
+  if(faces_count == 0)
+    return;
+
+  std::size_t const threads_count = Global::GetThreadsCount(i_threads_count);
+  std::size_t const chunk_size = 1 << 14;
+  m_face_bounds.resize(faces_count);
+  m_centroids.resize(faces_count);
+  m_faces.resize(faces_count);
+  Global::ParallelFor((faces_count + chunk_size - 1) / chunk_size, [&](std::size_t i_chunk)
+    {
+    for(std::size_t i = i_chunk * chunk_size; i < std::min(faces_count, (i_chunk + 1) * chunk_size); ++i)
+      {
+      if(!_GetPrecomputedBounds(i_mesh, i, m_face_bounds[i]))
+        {
+        m_face_bounds[i].Reset();
+        for(std::size_t corner = 0; corner < 3; ++corner)
+          {
+          auto const& vertex = vertices[std::get<0>(faces[i])[corner]];
+          float const point[3] = {vertex[0], vertex[1], vertex[2]};
+          m_face_bounds[i].Extend(point);
+          }
+        }
+      for(std::size_t k = 0; k < 3; ++k)
+        m_centroids[i][k] = 0.5f * (m_face_bounds[i].m_min[k] + m_face_bounds[i].m_max[k]);
+      m_faces[i] = static_cast<std::uint32_t>(i);
+      }
+    }, threads_count);
+
+  // Top levels: split the biggest range until every thread has a few subtrees
+  std::vector<_BuildNode> top;
+  top.push_back({_GetBounds(0, static_cast<std::uint32_t>(faces_count)), 0, static_cast<std::uint32_t>(faces_count), 0, false, {}});
+  std::vector<std::uint32_t> open_nodes(1, 0);
+  std::vector<std::uint32_t> subtree_roots;
+  while(!open_nodes.empty() && open_nodes.size() + subtree_roots.size() < 4 * threads_count)
+    {
+    auto const biggest = std::max_element(open_nodes.begin(), open_nodes.end(), [&](std::uint32_t i_left, std::uint32_t i_right)
+      {
+      return top[i_left].m_end - top[i_left].m_begin < top[i_right].m_end - top[i_right].m_begin;
+      });
+    std::uint32_t const node = *biggest;
+    open_nodes.erase(biggest);
+    if(top[node].m_end - top[node].m_begin < _MinParallelSize)
+      {
+      subtree_roots.push_back(node);
+      break; // the rest is smaller still
+      }
+
+    std::uint32_t middle = 0;
+    if(!_Split(top[node].m_begin, top[node].m_end, top[node].m_depth, middle))
+      {
+      top[node].m_is_leaf = true;
+      continue;
+      }
+    std::uint32_t const begin = top[node].m_begin, end = top[node].m_end, depth = top[node].m_depth + 1;
+    for(std::uint32_t side = 0; side < 2; ++side)
+      {
+      std::uint32_t const child_begin = side == 0 ? begin : middle;
+      std::uint32_t const child_end = side == 0 ? middle : end;
+      top[node].m_children[side] = {0, static_cast<std::uint32_t>(top.size())};
+      open_nodes.push_back(static_cast<std::uint32_t>(top.size()));
+      top.push_back({_GetBounds(child_begin, child_end), child_begin, child_end, depth, false, {}});
+      }
+    }
+  subtree_roots.insert(subtree_roots.end(), open_nodes.begin(), open_nodes.end());
+
+  // Disjoint face ranges, so subtrees are independent
+  std::vector<std::vector<_BuildNode>> trees(1 + subtree_roots.size());
+  Global::ParallelFor(subtree_roots.size(), [&](std::size_t i_subtree)
+    {
+    _BuildNode const& root = top[subtree_roots[i_subtree]];
+    _BuildSubtree(root.m_begin, root.m_end, root.m_depth, static_cast<std::uint32_t>(i_subtree + 1), trees[i_subtree + 1]);
+    }, threads_count);
+
+  // Top nodes handed over to subtrees are replaced by the subtree roots
+  std::vector<_Reference> references(top.size());
+  for(std::uint32_t i = 0; i < top.size(); ++i)
+    references[i] = {0, i};
+  for(std::size_t i = 0; i < subtree_roots.size(); ++i)
+    references[subtree_roots[i]] = {static_cast<std::uint32_t>(i + 1), 0};
+  for(_BuildNode& node : top)
+    if(!node.m_is_leaf)
+      for(_Reference& child : node.m_children)
+        child = references[child.m_node];
+  trees[0] = std::move(top);
+  _Flatten(trees, references[0]);
+
+  m_triangles.resize(faces_count);
+  Global::ParallelFor((faces_count + chunk_size - 1) / chunk_size, [&](std::size_t i_chunk)
+    {
+    for(std::size_t i = i_chunk * chunk_size; i < std::min(faces_count, (i_chunk + 1) * chunk_size); ++i)
+      {
+      auto const& indices = std::get<0>(faces[m_faces[i]]);
+      auto const& v0 = vertices[indices[0]];
+      auto const& v1 = vertices[indices[1]];
+      auto const& v2 = vertices[indices[2]];
+      for(std::size_t k = 0; k < 3; ++k)
+        {
+        m_triangles[i].m_origin[k] = v0[k];
+        m_triangles[i].m_edge1[k] = v1[k] - v0[k];
+        m_triangles[i].m_edge2[k] = v2[k] - v0[k];
+        }
+      }
+    }, threads_count);
+
+  std::vector<_Bounds>().swap(m_face_bounds);
+  std::vector<std::array<float, 3>>().swap(m_centroids);
+  }
+
+//-----------------------------------------------------------------------------
+inline std::vector<BoundingVolumeHierarchy::Node> const&
+BoundingVolumeHierarchy::nodes() const
+  {
+  return m_nodes;
+  }
+
+//-----------------------------------------------------------------------------
+inline std::size_t
+BoundingVolumeHierarchy::GetFacesCount() const
+  {
+  return m_faces.size();
+  }
+
+//-----------------------------------------------------------------------------
+inline bool
+BoundingVolumeHierarchy::Intersect(Ray const& i_ray, Hit& o_hit) const
+  {
+  if(m_nodes.empty())
+    return false;
+
+  float inverse_direction[3];
+  for(std::size_t k = 0; k < 3; ++k)
+    inverse_direction[k] = i_ray.m_direction[k] != 0.f ? 1.f / i_ray.m_direction[k] : std::numeric_limits<float>::max();
+
+  float max_distance = i_ray.m_max_distance;
+  bool is_hit = false;
+  float distance = 0.f;
+  if(!_IntersectBounds(m_nodes[0], i_ray.m_origin, inverse_direction, i_ray.m_min_distance, max_distance, distance))
+    return false;
+
+  std::uint32_t stack[_MaxDepth + 1];
+  std::size_t stack_size = 0;
+  std::uint32_t node_index = 0;
+  for(;;)
+    {
+    Node const& node = m_nodes[node_index];
+    if(node.m_count != 0)
+      {
+      // Moller-Trumbore
+      for(std::uint32_t i = node.m_first; i < node.m_first + node.m_count; ++i)
+        {
+        _Triangle const& triangle = m_triangles[i];
+        float const* d = i_ray.m_direction;
+        float const* e1 = triangle.m_edge1;
+        float const* e2 = triangle.m_edge2;
+        float const p[3] = {d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0]};
+        float const determinant = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+        if(determinant == 0.f)
+          continue;
+        float const inverse_determinant = 1.f / determinant;
+        float const s[3] = {i_ray.m_origin[0] - triangle.m_origin[0], i_ray.m_origin[1] - triangle.m_origin[1], i_ray.m_origin[2] - triangle.m_origin[2]};
+        float const u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverse_determinant;
+        if(u < 0.f || u > 1.f)
+          continue;
+        float const q[3] = {s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0]};
+        float const v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inverse_determinant;
+        if(v < 0.f || u + v > 1.f)
+          continue;
+        float const t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inverse_determinant;
+        if(t < i_ray.m_min_distance || t > max_distance)
+          continue;
+        max_distance = t;
+        is_hit = true;
+        o_hit.m_face = m_faces[i];
+        o_hit.m_distance = t;
+        o_hit.m_u = u;
+        o_hit.m_v = v;
+        }
+      }
+    else
+      {
+      // Nearer child first, the other one waits on the stack
+      std::uint32_t children[2] = {node_index + 1, node.m_first};
+      float distances[2];
+      bool const is_hit_child[2] = {
+        _IntersectBounds(m_nodes[children[0]], i_ray.m_origin, inverse_direction, i_ray.m_min_distance, max_distance, distances[0]),
+        _IntersectBounds(m_nodes[children[1]], i_ray.m_origin, inverse_direction, i_ray.m_min_distance, max_distance, distances[1])};
+      if(is_hit_child[0] && is_hit_child[1])
+        {
+        if(distances[1] < distances[0])
+          std::swap(children[0], children[1]);
+        assert(stack_size <= _MaxDepth);
+        stack[stack_size++] = children[1];
+        node_index = children[0];
+        continue;
+        }
+      if(is_hit_child[0] || is_hit_child[1])
+        {
+        node_index = is_hit_child[0] ? children[0] : children[1];
+        continue;
+        }
+      }
+
+    // Nodes on the stack may be farther than the hit found meanwhile
+    for(;;)
+      {
+      if(stack_size == 0)
+        return is_hit;
+      node_index = stack[--stack_size];
+      if(_IntersectBounds(m_nodes[node_index], i_ray.m_origin, inverse_direction, i_ray.m_min_distance, max_distance, distance))
+        break;
+      }
+    }
+  }
+
+//-----------------------------------------------------------------------------
+template<typename F>
+void
+BoundingVolumeHierarchy::QueryFrustum(Frustum const& i_frustum, F i_visitor) const
+  {
+  if(m_nodes.empty())
+    return;
+
+  std::uint32_t stack[_MaxDepth + 1];
+  std::size_t stack_size = 0;
+  stack[stack_size++] = 0;
+  while(stack_size != 0)
+    {
+    std::uint32_t const node_index = stack[--stack_size];
+    Node const& node = m_nodes[node_index];
+
+    // Nearest and farthest corners along every plane normal
+    bool is_inside = true;
+    bool is_outside = false;
+    for(Plane const& plane : i_frustum)
+      {
+      float nearest = plane.m_offset, farthest = plane.m_offset;
+      for(std::size_t k = 0; k < 3; ++k)
+        {
+        float const low = plane.m_normal[k] * node.m_min[k];
+        float const high = plane.m_normal[k] * node.m_max[k];
+        nearest += std::min(low, high);
+        farthest += std::max(low, high);
+        }
+      if(farthest < 0.f)
+        {
+        is_outside = true;
+        break;
+        }
+      is_inside = is_inside && nearest >= 0.f;
+      }
+    if(is_outside)
+      continue;
+
+    if(node.m_count != 0 || is_inside)
+      {
+      // Subtree triangles are contiguous: the range ends where the next sibling range starts
+      std::uint32_t first = node.m_first, last = node.m_first + node.m_count;
+      if(node.m_count == 0)
+        {
+        std::uint32_t leftmost = node_index, rightmost = node_index;
+        while(m_nodes[leftmost].m_count == 0)
+          ++leftmost;
+        while(m_nodes[rightmost].m_count == 0)
+          rightmost = m_nodes[rightmost].m_first;
+        first = m_nodes[leftmost].m_first;
+        last = m_nodes[rightmost].m_first + m_nodes[rightmost].m_count;
+        }
+      for(std::uint32_t i = first; i < last; ++i)
+        i_visitor(static_cast<std::size_t>(m_faces[i]));
+      continue;
+      }
+
+    assert(stack_size + 2 <= _MaxDepth + 1);
+    stack[stack_size++] = node.m_first;
+    stack[stack_size++] = node_index + 1;
+    }
+  }
+
+//-----------------------------------------------------------------------------
+inline BoundingVolumeHierarchy::Frustum
+BoundingVolumeHierarchy::GetFrustum(Transform const& i_transform, int i_width, int i_height)
+  {
+  // x = row0 / row3 >= 0 is row0 >= 0 where row3 > 0, and so on
+  Frustum frustum;
+  float const scales[5][2] = {{1.f, 0.f}, {-1.f, static_cast<float>(i_width)}, {1.f, 0.f}, {-1.f, static_cast<float>(i_height)}, {0.f, 1.f}};
+  DimensionType const rows[5] = {0, 0, 1, 1, 3};
+  for(std::size_t i = 0; i < frustum.size(); ++i)
+    {
+    for(DimensionType k = 0; k < 3; ++k)
+      frustum[i].m_normal[k] = scales[i][0] * i_transform(rows[i], k) + scales[i][1] * i_transform(3, k);
+    frustum[i].m_offset = scales[i][0] * i_transform(rows[i], 3) + scales[i][1] * i_transform(3, 3);
+    }
+  return frustum;
+  }
+
+//-----------------------------------------------------------------------------
+inline BoundingVolumeHierarchy::Ray
+BoundingVolumeHierarchy::GetScreenRay(Transform const& i_transform, float i_x, float i_y)
+  {
+  // Points of screen depth z are the null vectors of row0 - x row3, row1 - y row3 and row2 - z row3
+  double points[2][4];
+  for(int depth = 0; depth < 2; ++depth)
+    {
+    double const screen[3] = {i_x, i_y, static_cast<double>(depth)};
+    double planes[3][4];
+    for(DimensionType row = 0; row < 3; ++row)
+      for(DimensionType column = 0; column < 4; ++column)
+        planes[row][column] = i_transform(row, column) - screen[row] * i_transform(3, column);
+    GetHomogeneousCrossProduct(planes[0], planes[1], planes[2], points[depth]);
+    }
+  double rows[3][4];
+  for(DimensionType row = 0; row < 4; ++row)
+    {
+    rows[0][row] = i_transform(0, row);
+    rows[1][row] = i_transform(1, row);
+    rows[2][row] = i_transform(3, row);
+    }
+  double camera[4];
+  GetHomogeneousCrossProduct(rows[0], rows[1], rows[2], camera);
+
+  Ray ray;
+  double const scale = std::max(std::max(std::fabs(camera[0]), std::fabs(camera[1])), std::fabs(camera[2]));
+  bool const is_perspective = std::fabs(camera[3]) > 1e-9 * scale;
+  double direction_length = 0.0;
+  for(std::size_t k = 0; k < 3; ++k)
+    {
+    // From depth 1 to depth 0 goes away from the viewer
+    double const direction = points[0][k] / points[0][3] - points[1][k] / points[1][3];
+    ray.m_origin[k] = static_cast<float>(is_perspective ? camera[k] / camera[3] : points[1][k] / points[1][3]);
+    ray.m_direction[k] = static_cast<float>(direction);
+    direction_length += direction * direction;
+    }
+  direction_length = std::sqrt(direction_length);
+  for(std::size_t k = 0; k < 3; ++k)
+    ray.m_direction[k] = direction_length > 0.0 ? static_cast<float>(ray.m_direction[k] / direction_length) : 0.f;
+  ray.m_min_distance = is_perspective ? 0.f : -std::numeric_limits<float>::max();
+  ray.m_max_distance = std::numeric_limits<float>::max();
+  return ray;
+  }
+
+//-----------------------------------------------------------------------------
+inline bool
+BoundingVolumeHierarchy::_Split(std::uint32_t i_begin, std::uint32_t i_end, std::uint32_t i_depth, std::uint32_t& o_middle)
+  {
+  std::size_t const count = i_end - i_begin;
+  if(count <= 2 || i_depth + 1 >= _MaxDepth)
+    return false;
+
+  _Bounds centroid_bounds;
+  centroid_bounds.Reset();
+  for(std::uint32_t i = i_begin; i < i_end; ++i)
+    {
+    float const centroid[3] = {m_centroids[m_faces[i]][0], m_centroids[m_faces[i]][1], m_centroids[m_faces[i]][2]};
+    centroid_bounds.Extend(centroid);
+    }
+
+  // Cost relative to one triangle test: 1 traversal step + area weighted children
+  float best_cost = std::numeric_limits<float>::max();
+  std::size_t best_axis = 0, best_bin = 0;
+  for(std::size_t axis = 0; axis < 3; ++axis)
+    {
+    float const extent = centroid_bounds.m_max[axis] - centroid_bounds.m_min[axis];
+    if(!(extent > 0.f))
+      continue;
+    float const bin_scale = _BinsCount / extent;
+    _Bounds bins[_BinsCount];
+    std::size_t counts[_BinsCount] = {};
+    for(auto& bin : bins)
+      bin.Reset();
+    for(std::uint32_t i = i_begin; i < i_end; ++i)
+      {
+      std::size_t const bin = std::min(_BinsCount - 1, static_cast<std::size_t>((m_centroids[m_faces[i]][axis] - centroid_bounds.m_min[axis]) * bin_scale));
+      bins[bin].Extend(m_face_bounds[m_faces[i]]);
+      ++counts[bin];
+      }
+
+    // Right to left sweep stores the right side costs, left to right one adds the left sides
+    float right_costs[_BinsCount];
+    _Bounds right;
+    right.Reset();
+    std::size_t right_count = 0;
+    for(std::size_t bin = _BinsCount - 1; bin > 0; --bin)
+      {
+      right.Extend(bins[bin]);
+      right_count += counts[bin];
+      right_costs[bin] = right_count != 0 ? right.GetHalfArea() * right_count : 0.f;
+      }
+    _Bounds left;
+    left.Reset();
+    std::size_t left_count = 0;
+    for(std::size_t bin = 0; bin + 1 < _BinsCount; ++bin)
+      {
+      left.Extend(bins[bin]);
+      left_count += counts[bin];
+      if(left_count == 0 || left_count == count)
+        continue;
+      float const cost = left.GetHalfArea() * left_count + right_costs[bin + 1];
+      if(cost < best_cost)
+        {
+        best_cost = cost;
+        best_axis = axis;
+        best_bin = bin + 1;
+        }
+      }
+    }
+
+  if(best_cost == std::numeric_limits<float>::max())
+    return false; // all centroids coincide, no split separates them
+  float const area = _GetBounds(i_begin, i_end).GetHalfArea();
+  if(count <= _MaxLeafSize && (area <= 0.f || 1.f + best_cost / area >= static_cast<float>(count)))
+    return false;
+
+  float const extent = centroid_bounds.m_max[best_axis] - centroid_bounds.m_min[best_axis];
+  float const bin_scale = _BinsCount / extent;
+  float const minimum = centroid_bounds.m_min[best_axis];
+  auto const middle = std::partition(m_faces.begin() + i_begin, m_faces.begin() + i_end, [&](std::uint32_t i_face)
+    {
+    return std::min(_BinsCount - 1, static_cast<std::size_t>((m_centroids[i_face][best_axis] - minimum) * bin_scale)) < best_bin;
+    });
+  o_middle = static_cast<std::uint32_t>(middle - m_faces.begin());
+  assert(o_middle > i_begin && o_middle < i_end);
+  return true;
+  }
+
+//-----------------------------------------------------------------------------
+inline BoundingVolumeHierarchy::_Bounds
+BoundingVolumeHierarchy::_GetBounds(std::uint32_t i_begin, std::uint32_t i_end) const
+  {
+  _Bounds bounds;
+  bounds.Reset();
+  for(std::uint32_t i = i_begin; i < i_end; ++i)
+    bounds.Extend(m_face_bounds[m_faces[i]]);
+  return bounds;
+  }
+
+//-----------------------------------------------------------------------------
+inline void
+BoundingVolumeHierarchy::_BuildSubtree(std::uint32_t i_begin, std::uint32_t i_end, std::uint32_t i_depth, std::uint32_t i_tree,
+                                       std::vector<_BuildNode>& io_nodes)
+  {
+  std::uint32_t const node = static_cast<std::uint32_t>(io_nodes.size());
+  io_nodes.push_back({_GetBounds(i_begin, i_end), i_begin, i_end, i_depth, true, {}});
+  std::uint32_t middle = 0;
+  if(!_Split(i_begin, i_end, i_depth, middle))
+    return;
+
+  io_nodes[node].m_is_leaf = false;
+  io_nodes[node].m_children[0] = {i_tree, static_cast<std::uint32_t>(io_nodes.size())};
+  _BuildSubtree(i_begin, middle, i_depth + 1, i_tree, io_nodes);
+  io_nodes[node].m_children[1] = {i_tree, static_cast<std::uint32_t>(io_nodes.size())};
+  _BuildSubtree(middle, i_end, i_depth + 1, i_tree, io_nodes);
+  }
+
+//-----------------------------------------------------------------------------
+inline void
+BoundingVolumeHierarchy::_Flatten(std::vector<std::vector<_BuildNode>> const& i_trees, _Reference const& i_root)
+  {
+  std::size_t nodes_count = 0;
+  for(auto const& tree : i_trees)
+    nodes_count += tree.size();
+  m_nodes.clear();
+  m_nodes.reserve(nodes_count);
+
+  // Depth-first, left first; right child index is patched into the parent when it is reached
+  std::vector<std::uint32_t> triangles_order;
+  triangles_order.reserve(m_faces.size());
+  std::vector<std::pair<_Reference, std::uint32_t>> stack(1, std::make_pair(i_root, std::numeric_limits<std::uint32_t>::max()));
+  while(!stack.empty())
+    {
+    _Reference const reference = stack.back().first;
+    std::uint32_t const parent = stack.back().second;
+    stack.pop_back();
+
+    _BuildNode const* p_node = &i_trees[reference.m_tree][reference.m_node];
+
+    std::uint32_t const index = static_cast<std::uint32_t>(m_nodes.size());
+    if(parent != std::numeric_limits<std::uint32_t>::max())
+      m_nodes[parent].m_first = index;
+
+    Node node;
+    for(std::size_t k = 0; k < 3; ++k)
+      {
+      node.m_min[k] = p_node->m_bounds.m_min[k];
+      node.m_max[k] = p_node->m_bounds.m_max[k];
+      }
+    if(p_node->m_is_leaf)
+      {
+      node.m_first = static_cast<std::uint32_t>(triangles_order.size());
+      node.m_count = p_node->m_end - p_node->m_begin;
+      triangles_order.insert(triangles_order.end(), m_faces.begin() + p_node->m_begin, m_faces.begin() + p_node->m_end);
+      m_nodes.push_back(node);
+      continue;
+      }
+    node.m_first = 0;
+    node.m_count = 0;
+    m_nodes.push_back(node);
+    stack.push_back(std::make_pair(p_node->m_children[1], index));
+    stack.push_back(std::make_pair(p_node->m_children[0], std::numeric_limits<std::uint32_t>::max()));
+    }
+  m_faces.swap(triangles_order);
+  }
+
+//-----------------------------------------------------------------------------
+inline bool
+BoundingVolumeHierarchy::_IntersectBounds(Node const& i_node, float const (&i_origin)[3], float const (&i_inverse_direction)[3],
+                                          float i_min_distance, float i_max_distance, float& o_distance)
+  {
+  float near_distance = i_min_distance, far_distance = i_max_distance;
+  for(std::size_t k = 0; k < 3; ++k)
+    {
+    float t0 = (i_node.m_min[k] - i_origin[k]) * i_inverse_direction[k];
+    float t1 = (i_node.m_max[k] - i_origin[k]) * i_inverse_direction[k];
+    if(t0 > t1)
+      std::swap(t0, t1);
+    near_distance = std::max(near_distance, t0);
+    far_distance = std::min(far_distance, t1);
+    }
+  o_distance = near_distance;
+  return near_distance <= far_distance;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TMesh>
+bool
+BoundingVolumeHierarchy::_GetPrecomputedBounds(TMesh const&, std::size_t, _Bounds&)
+  {
+  return false;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
+bool
+BoundingVolumeHierarchy::_GetPrecomputedBounds(Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType> const& i_mesh,
+                                               std::size_t i_face, _Bounds& o_bounds)
+  {
+  if(!i_mesh.HasFaceData())
+    return false;
+  auto const& bounds = i_mesh.face_bounds()[i_face];
+  for(std::size_t k = 0; k < 3; ++k)
+    {
+    o_bounds.m_min[k] = bounds.m_min[k];
+    o_bounds.m_max[k] = bounds.m_max[k];
+    }
+  return true;
+  }
+
+//-----------------------------------------------------------------------------
+inline void
+BoundingVolumeHierarchy::_Bounds::Reset()
+  {
+  for(std::size_t k = 0; k < 3; ++k)
+    {
+    m_min[k] = std::numeric_limits<float>::max();
+    m_max[k] = -std::numeric_limits<float>::max();
+    }
+  }
+
+//-----------------------------------------------------------------------------
+inline void
+BoundingVolumeHierarchy::_Bounds::Extend(_Bounds const& i_bounds)
+  {
+  for(std::size_t k = 0; k < 3; ++k)
+    {
+    m_min[k] = std::min(m_min[k], i_bounds.m_min[k]);
+    m_max[k] = std::max(m_max[k], i_bounds.m_max[k]);
+    }
+  }
+
+//-----------------------------------------------------------------------------
+inline void
+BoundingVolumeHierarchy::_Bounds::Extend(float const (&i_point)[3])
+  {
+  for(std::size_t k = 0; k < 3; ++k)
+    {
+    m_min[k] = std::min(m_min[k], i_point[k]);
+    m_max[k] = std::max(m_max[k], i_point[k]);
+    }
+  }
+
+//-----------------------------------------------------------------------------
+inline float
+BoundingVolumeHierarchy::_Bounds::GetHalfArea() const
+  {
+  float const x = m_max[0] - m_min[0], y = m_max[1] - m_min[1], z = m_max[2] - m_min[2];
+  return x * y + y * z + z * x;
+  }
+
+
+} // namespace Geometry
@@ -0,0 +1,334 @@
+
+#pragma once
+
+#include "./IndexedMesh.h"
+#include "./Mesh.h"
+#include "./Vector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace Geometry {
+
+
+///////////////////////////////////////////////////////////////////////////////
+// FaceOrderOptimizer // struct declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Offline reordering of triangle lists given as 3 vertex indices per triangle.
+// Orders are returned as permutations: order[new position] = old triangle.
+//  - GetVertexCacheOrder: Tom Forsyth's "Linear-speed vertex cache optimisation",
+//    greedy choice of the best scored triangle adjacent to a simulated LRU cache.
+//  - SortClustersForOverdraw: cuts an order into clusters of consecutive triangles
+//    and sorts them so that the ones facing outwards (likely occluders) go first,
+//    as in Sander et al. "Fast triangle reordering for vertex locality and reduced overdraw".
+//  - GetACMR: average cache miss ratio (transformed vertices per triangle) of a FIFO cache.
+struct FaceOrderOptimizer
+  {
+  using Index = std::uint32_t;
+
+  static constexpr std::size_t CacheSize = 32;       // LRU size the optimization aims at
+  static constexpr std::size_t ACMRCacheSize = 16;   // FIFO size ACMR is usually reported for
+  static constexpr std::size_t ClusterSize = 64;     // triangles per overdraw cluster
+
+  static double GetACMR(std::vector<Index> const& i_indices, std::size_t i_cache_size = ACMRCacheSize);
+
+  static std::vector<std::size_t> GetVertexCacheOrder(std::vector<Index> const& i_indices, std::size_t i_vertices_count);
+
+  // i_get_position(vertex index) returns a point with x, y, z accessible by operator[]
+  template<typename FPosition>
+  static void SortClustersForOverdraw(std::vector<Index> const& i_indices, FPosition i_get_position,
+                                      std::vector<std::size_t>& io_order, std::size_t i_cluster_size = ClusterSize);
+
+  static std::vector<Index> Reorder(std::vector<Index> const& i_indices, std::vector<std::size_t> const& i_order);
+
+  private:
+    static float _GetVertexScore(int i_cache_position, std::size_t i_remaining_triangles);
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// FaceOrderStatistics // struct declaration //
+///////////////////////////////////////////////////////////////////////////////
+struct FaceOrderStatistics
+  {
+  double m_acmr_before;
+  double m_acmr_after;
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// OptimizeFaceOrder // function declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Reorders mesh faces for vertex cache reuse and, optionally, for less overdraw.
+// For Mesh the cache key is the position index, for IndexedMesh the vertex index.
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
+FaceOrderStatistics OptimizeFaceOrder(Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>& io_mesh, bool i_reduce_overdraw = true);
+
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+FaceOrderStatistics OptimizeFaceOrder(IndexedMesh<TVertexType, TTextureType, TNormalType>& io_mesh, bool i_reduce_overdraw = true);
+
+
+///////////////////////////////////////////////////////////////////////////////
+// FaceOrderOptimizer // struct definition //
+///////////////////////////////////////////////////////////////////////////////
+inline double
+FaceOrderOptimizer::GetACMR(std::vector<Index> const& i_indices, std::size_t i_cache_size)
+  {
+  std::size_t const triangles_count = i_indices.size() / 3;
+  if(triangles_count == 0)
+    return 0.0;
+
+  // FIFO: time stamps instead of a queue, a vertex is cached if it was pushed at most i_cache_size misses ago
+  Index max_index = 0;
+  for(Index index : i_indices)
+    max_index = std::max(max_index, index);
+  std::vector<std::size_t> pushed_at(static_cast<std::size_t>(max_index) + 1, 0);
+  std::size_t misses = 0;
+  for(Index index : i_indices)
+    {
+    if(pushed_at[index] != 0 && misses + 1 - pushed_at[index] <= i_cache_size)
+      continue;
+    ++misses;
+    pushed_at[index] = misses;
+    }
+  return static_cast<double>(misses) / static_cast<double>(triangles_count);
+  }
+
+//-----------------------------------------------------------------------------
+inline float
+FaceOrderOptimizer::_GetVertexScore(int i_cache_position, std::size_t i_remaining_triangles)
+  {
+  if(i_remaining_triangles == 0)
+    return -1.f; // nothing to draw with it anymore
+
+  float score = 0.f;
+  if(i_cache_position >= 0)
+    {
+    // Vertices of the last triangle get a fixed score, so the next one doesn't just use them again
+    if(i_cache_position < 3)
+      score = 0.75f;
+    else
+      score = std::pow(1.f - static_cast<float>(i_cache_position - 3) / static_cast<float>(CacheSize - 3), 1.5f);
+    }
+  // Boost vertices with few triangles left, so lone triangles don't get stranded
+  return score + 2.f / std::sqrt(static_cast<float>(i_remaining_triangles));
+  }
+
+//-----------------------------------------------------------------------------
+inline std::vector<std::size_t>
+FaceOrderOptimizer::GetVertexCacheOrder(std::vector<Index> const& i_indices, std::size_t i_vertices_count)
+  {
+  std::size_t const triangles_count = i_indices.size() / 3;
+
+  // Triangles of every vertex; the first m_remaining[v] entries are the ones not added yet
+  std::vector<std::size_t> offsets(i_vertices_count + 1, 0);
+  for(std::size_t i = 0; i < 3 * triangles_count; ++i)
+    ++offsets[i_indices[i] + 1];
+  for(std::size_t v = 0; v < i_vertices_count; ++v)
+    offsets[v + 1] += offsets[v];
+  std::vector<std::size_t> vertex_triangles(3 * triangles_count);
+  std::vector<std::size_t> remaining(i_vertices_count, 0);
+  for(std::size_t i = 0; i < 3 * triangles_count; ++i)
+    {
+    Index const v = i_indices[i];
+    vertex_triangles[offsets[v] + remaining[v]++] = i / 3;
+    }
+
+  std::vector<int> cache_positions(i_vertices_count, -1);
+  std::vector<float> vertex_scores(i_vertices_count);
+  for(std::size_t v = 0; v < i_vertices_count; ++v)
+    vertex_scores[v] = _GetVertexScore(-1, remaining[v]);
+  std::vector<float> triangle_scores(triangles_count);
+  for(std::size_t t = 0; t < triangles_count; ++t)
+    triangle_scores[t] = vertex_scores[i_indices[3 * t]] + vertex_scores[i_indices[3 * t + 1]] + vertex_scores[i_indices[3 * t + 2]];
+  std::vector<unsigned char> is_added(triangles_count, 0);
+
+  std::vector<Index> cache;
+  std::vector<Index> new_cache;
+  cache.reserve(CacheSize + 3);
+  new_cache.reserve(CacheSize + 3);
+
+  std::vector<std::size_t> order;
+  order.reserve(triangles_count);
+  std::size_t next_unadded = 0;
+  std::size_t best_triangle = triangles_count;
+  while(order.size() < triangles_count)
+    {
+    if(best_triangle == triangles_count)
+      {
+      // Cache doesn't touch any triangle left: restart from the source order
+      while(is_added[next_unadded])
+        ++next_unadded;
+      best_triangle = next_unadded;
+      }
+    is_added[best_triangle] = 1;
+    order.push_back(best_triangle);
+
+    // LRU update: triangle vertices go to the front, the rest keeps its order
+    Index const* p_triangle = &i_indices[3 * best_triangle];
+    new_cache.clear();
+    for(std::size_t corner = 0; corner < 3; ++corner)
+      {
+      Index const v = p_triangle[corner];
+      if(std::find(new_cache.begin(), new_cache.end(), v) == new_cache.end())
+        new_cache.push_back(v);
+      // Remove the triangle from the not added ones of the vertex
+      std::size_t* p_begin = &vertex_triangles[offsets[v]];
+      std::size_t* p_end = p_begin + remaining[v];
+      std::swap(*std::find(p_begin, p_end, best_triangle), *(p_end - 1));
+      --remaining[v];
+      }
+    for(Index v : cache)
+      if(std::find(new_cache.begin(), new_cache.end(), v) == new_cache.end())
+        new_cache.push_back(v);
+
+    // Rescore vertices whose position changed (including the ones pushed out) and their triangles
+    for(std::size_t i = 0; i < new_cache.size(); ++i)
+      {
+      Index const v = new_cache[i];
+      cache_positions[v] = i < CacheSize ? static_cast<int>(i) : -1;
+      vertex_scores[v] = _GetVertexScore(cache_positions[v], remaining[v]);
+      }
+    best_triangle = triangles_count;
+    float best_score = -1.f;
+    for(Index v : new_cache)
+      for(std::size_t i = 0; i < remaining[v]; ++i)
+        {
+        std::size_t const t = vertex_triangles[offsets[v] + i];
+        Index const* p_adjacent = &i_indices[3 * t];
+        triangle_scores[t] = vertex_scores[p_adjacent[0]] + vertex_scores[p_adjacent[1]] + vertex_scores[p_adjacent[2]];
+        if(cache_positions[v] >= 0 && triangle_scores[t] > best_score)
+          {
+          best_score = triangle_scores[t];
+          best_triangle = t;
+          }
+        }
+
+    if(new_cache.size() > CacheSize)
+      new_cache.resize(CacheSize);
+    cache.swap(new_cache);
+    }
+  return order;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename FPosition>
+void
+FaceOrderOptimizer::SortClustersForOverdraw(std::vector<Index> const& i_indices, FPosition i_get_position,
+                                            std::vector<std::size_t>& io_order, std::size_t i_cluster_size)
+  {
+  using Vec = Vector<double, 3>;
+  auto const get_point = [&](Index i_index)
+    {
+    auto const& position = i_get_position(i_index);
+    return Vec(position[0], position[1], position[2]);
+    };
+
+  struct Cluster
+    {
+    std::size_t m_begin;
+    std::size_t m_end;
+    double m_key;
+    };
+  std::vector<Cluster> clusters;
+  std::vector<Vec> centroids;
+  std::vector<Vec> normals;
+  Vec mesh_centroid(0.0, 0.0, 0.0);
+  for(std::size_t begin = 0; begin < io_order.size(); begin += i_cluster_size)
+    {
+    std::size_t const end = std::min(begin + i_cluster_size, io_order.size());
+    Vec centroid(0.0, 0.0, 0.0);
+    Vec normal(0.0, 0.0, 0.0); // area weighted
+    for(std::size_t i = begin; i < end; ++i)
+      {
+      Index const* p_triangle = &i_indices[3 * io_order[i]];
+      Vec const v1 = get_point(p_triangle[0]);
+      Vec const v2 = get_point(p_triangle[1]);
+      Vec const v3 = get_point(p_triangle[2]);
+      centroid += (v1 + v2 + v3) * (1.0 / 3.0);
+      normal += (v2 - v1) ^ (v3 - v1);
+      }
+    mesh_centroid += centroid;
+    centroids.push_back(centroid * (1.0 / static_cast<double>(end - begin)));
+    normals.push_back(normal);
+    clusters.push_back({begin, end, 0.0});
+    }
+  if(clusters.empty())
+    return;
+  mesh_centroid *= 1.0 / static_cast<double>(io_order.size());
+
+  // Clusters far out along their own normal occlude the rest of the mesh from most viewpoints
+  for(std::size_t i = 0; i < clusters.size(); ++i)
+    {
+    double const length = normals[i].GetLength();
+    clusters[i].m_key = length > 0.0 ? ((centroids[i] - mesh_centroid) * normals[i]) / length : 0.0;
+    }
+  std::stable_sort(clusters.begin(), clusters.end(), [](Cluster const& i_a, Cluster const& i_b) { return i_a.m_key > i_b.m_key; });
+
+  std::vector<std::size_t> order;
+  order.reserve(io_order.size());
+  for(Cluster const& cluster : clusters)
+    order.insert(order.end(), io_order.begin() + cluster.m_begin, io_order.begin() + cluster.m_end);
+  io_order.swap(order);
+  }
+
+//-----------------------------------------------------------------------------
+inline std::vector<FaceOrderOptimizer::Index>
+FaceOrderOptimizer::Reorder(std::vector<Index> const& i_indices, std::vector<std::size_t> const& i_order)
+  {
+  std::vector<Index> indices;
+  indices.reserve(3 * i_order.size());
+  for(std::size_t triangle : i_order)
+    indices.insert(indices.end(), i_indices.begin() + 3 * triangle, i_indices.begin() + 3 * triangle + 3);
+  return indices;
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// OptimizeFaceOrder // function definition //
+///////////////////////////////////////////////////////////////////////////////
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
+FaceOrderStatistics OptimizeFaceOrder(Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>& io_mesh, bool i_reduce_overdraw)
+  {
+  using Index = FaceOrderOptimizer::Index;
+  std::vector<Index> indices;
+  indices.reserve(3 * io_mesh.faces().size());
+  for(auto const& face : io_mesh.faces())
+    for(std::size_t corner = 0; corner < 3; ++corner)
+      indices.push_back(static_cast<Index>(std::get<0>(face)[corner]));
+
+  std::vector<std::size_t> order = FaceOrderOptimizer::GetVertexCacheOrder(indices, io_mesh.vertices().size());
+  if(i_reduce_overdraw)
+    FaceOrderOptimizer::SortClustersForOverdraw(indices, [&](Index i_index) -> TVertexType const& { return io_mesh.vertex(i_index); }, order);
+
+  FaceOrderStatistics statistics;
+  statistics.m_acmr_before = FaceOrderOptimizer::GetACMR(indices);
+  statistics.m_acmr_after = FaceOrderOptimizer::GetACMR(FaceOrderOptimizer::Reorder(indices, order));
+  io_mesh.ReorderFaces(order);
+  return statistics;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+FaceOrderStatistics OptimizeFaceOrder(IndexedMesh<TVertexType, TTextureType, TNormalType>& io_mesh, bool i_reduce_overdraw)
+  {
+  using Index = FaceOrderOptimizer::Index;
+  auto const& vertices = io_mesh.vertices();
+  std::vector<std::size_t> order = FaceOrderOptimizer::GetVertexCacheOrder(io_mesh.indices(), vertices.size());
+  if(i_reduce_overdraw)
+    FaceOrderOptimizer::SortClustersForOverdraw(io_mesh.indices(),
+                                                [&](Index i_index) -> TVertexType const& { return vertices[i_index].m_position; }, order);
+
+  FaceOrderStatistics statistics;
+  statistics.m_acmr_before = FaceOrderOptimizer::GetACMR(io_mesh.indices());
+  io_mesh.ReorderFaces(order);
+  statistics.m_acmr_after = FaceOrderOptimizer::GetACMR(io_mesh.indices());
+  return statistics;
+  }
+
+
+} // namespace Geometry
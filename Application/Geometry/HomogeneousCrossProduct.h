@@ -0,0 +1,32 @@
+
+#pragma once
+
+
+namespace Geometry {
+
+
+///////////////////////////////////////////////////////////////////////////////
+// GetHomogeneousCrossProduct // function definition //
+///////////////////////////////////////////////////////////////////////////////
+// 4D generalization of the cross product: o[j] = (-1)^j * minor of the 3x4
+// matrix [a; b; c] without column j. The result is orthogonal to a, b and c,
+// so for three rows of a projective transform it is the homogeneous point all
+// of them map to zero (e.g. rows x, y, w give the camera), and for three
+// homogeneous points it is the plane through them.
+inline void GetHomogeneousCrossProduct(double const (&i_a)[4], double const (&i_b)[4], double const (&i_c)[4], double (&o_result)[4])
+  {
+  for(int j = 0; j < 4; ++j)
+    {
+    int columns[3];
+    for(int k = 0, c = 0; k < 4; ++k)
+      if(k != j)
+        columns[c++] = k;
+    double const minor = i_a[columns[0]] * (i_b[columns[1]] * i_c[columns[2]] - i_b[columns[2]] * i_c[columns[1]])
+                       - i_a[columns[1]] * (i_b[columns[0]] * i_c[columns[2]] - i_b[columns[2]] * i_c[columns[0]])
+                       + i_a[columns[2]] * (i_b[columns[0]] * i_c[columns[1]] - i_b[columns[1]] * i_c[columns[0]]);
+    o_result[j] = (j % 2 == 0) ? minor : -minor;
+    }
+  }
+
+
+} // namespace Geometry
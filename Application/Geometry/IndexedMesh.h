@@ -0,0 +1,154 @@
+
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+
+namespace Geometry {
+
+
+///////////////////////////////////////////////////////////////////////////////
+// IndexedMesh // class declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Single vertex stream: every distinct (v, vt, vn) triplet of the source mesh
+// is one interleaved Vertex, triangles are three 32-bit indices into it.
+// Triangles keep the source face order, vertices are numbered by first use.
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+class IndexedMesh
+  {
+  public:
+    using VertexType = TVertexType;
+    using TextureType = TTextureType;
+    using NormalType = TNormalType;
+    using Index = std::uint32_t;
+
+    struct Vertex
+      {
+      TVertexType m_position;
+      TTextureType m_texture;
+      TNormalType m_normal;
+      };
+
+    template<typename TMesh>
+    explicit IndexedMesh(TMesh const& i_mesh); // Mesh, MappedMesh
+    IndexedMesh(std::vector<Vertex>&& i_vertices, std::vector<Index>&& i_indices);
+
+    std::vector<Vertex> const& vertices() const;
+    std::vector<Index> const& indices() const; // 3 per triangle
+    std::size_t GetTrianglesCount() const;
+
+    void ReorderFaces(std::vector<std::size_t> const& i_order); // i_order[new position] = old triangle index
+
+  private:
+    struct _TripletHash
+      {
+      std::size_t operator()(std::array<std::size_t, 3> const& i_triplet) const;
+      };
+
+    std::vector<Vertex> m_vertices;
+    std::vector<Index>  m_indices;
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// IndexedMesh // class definition //
+///////////////////////////////////////////////////////////////////////////////
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+template<typename TMesh>
+IndexedMesh<TVertexType, TTextureType, TNormalType>::IndexedMesh(TMesh const& i_mesh)
+  {
+  auto const& faces = i_mesh.faces();
+  auto const& textures = i_mesh.textures();
+  auto const& normals = i_mesh.normals();
+
+  std::unordered_map<std::array<std::size_t, 3>, Index, _TripletHash> vertex_ids;
+  vertex_ids.reserve(i_mesh.vertices().size() * 2); // seams usually double only some of the positions
+  m_indices.reserve(3 * faces.size());
+  for(auto const& face : faces)
+    {
+    for(std::size_t i = 0; i < 3; ++i)
+      {
+      std::array<std::size_t, 3> const triplet = {{std::get<0>(face)[i], std::get<1>(face)[i], std::get<2>(face)[i]}};
+      auto const inserted = vertex_ids.emplace(triplet, static_cast<Index>(m_vertices.size()));
+      if(inserted.second)
+        {
+        assert(m_vertices.size() < std::numeric_limits<Index>::max());
+        // Meshes without texture coordinates or normals still refer to them in faces
+        Vertex vertex = {i_mesh.vertex(triplet[0]), TTextureType(), TNormalType()};
+        if(triplet[1] < textures.size())
+          vertex.m_texture = textures[triplet[1]];
+        if(triplet[2] < normals.size())
+          vertex.m_normal = normals[triplet[2]];
+        m_vertices.push_back(vertex);
+        }
+      m_indices.push_back(inserted.first->second);
+      }
+    }
+  m_vertices.shrink_to_fit();
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+IndexedMesh<TVertexType, TTextureType, TNormalType>::IndexedMesh(std::vector<Vertex>&& i_vertices, std::vector<Index>&& i_indices)
+  : m_vertices(std::move(i_vertices))
+  , m_indices(std::move(i_indices))
+  {
+  assert(m_indices.size() % 3 == 0);
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+std::vector<typename IndexedMesh<TVertexType, TTextureType, TNormalType>::Vertex> const&
+IndexedMesh<TVertexType, TTextureType, TNormalType>::vertices() const
+  {
+  return m_vertices;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+std::vector<typename IndexedMesh<TVertexType, TTextureType, TNormalType>::Index> const&
+IndexedMesh<TVertexType, TTextureType, TNormalType>::indices() const
+  {
+  return m_indices;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+std::size_t
+IndexedMesh<TVertexType, TTextureType, TNormalType>::GetTrianglesCount() const
+  {
+  return m_indices.size() / 3;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+void
+IndexedMesh<TVertexType, TTextureType, TNormalType>::ReorderFaces(std::vector<std::size_t> const& i_order)
+  {
+  std::vector<Index> indices;
+  indices.reserve(3 * i_order.size());
+  for(std::size_t triangle : i_order)
+    indices.insert(indices.end(), m_indices.begin() + 3 * triangle, m_indices.begin() + 3 * triangle + 3);
+  m_indices.swap(indices);
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+std::size_t
+IndexedMesh<TVertexType, TTextureType, TNormalType>::_TripletHash::operator()(std::array<std::size_t, 3> const& i_triplet) const
+  {
+  std::size_t hash = i_triplet[0];
+  hash = hash * 0x9E3779B97F4A7C15ull + i_triplet[1];
+  hash = hash * 0x9E3779B97F4A7C15ull + i_triplet[2];
+  return hash ^ (hash >> 29);
+  }
+
+
+} // namespace Geometry
@@ -0,0 +1,232 @@
+
+#pragma once
+
+#include "./FaceOrderOptimizer.h"
+#include "./MappedMesh.h"
+#include "./Matrix.h"
+#include "./MeshSimplifier.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+
+
+namespace Geometry {
+
+
+///////////////////////////////////////////////////////////////////////////////
+// LevelsOfDetail // class declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Chain of progressively simplified copies of one mesh, mapped from the files
+// "<base>.lod0.mesh", "<base>.lod1.mesh", ... written by WriteLevelsOfDetail().
+// Level 0 is the source mesh. A level is chosen per draw from the size of the
+// mesh bounding box on the screen, so small views rasterize few faces.
+// Given i_source_filename, the chain opens only if level 0 was written from the
+// current version of that file (see MeshCacheHeader), so an edited obj is never
+// drawn from an older cache.
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+class LevelsOfDetail
+  {
+  public:
+    using Level = MappedMesh<TVertexType, TTextureType, TNormalType>;
+    using Transform = Matrix<float, 4, 4>;
+
+    static constexpr double DefaultPixelsPerFace = 16.0; // smaller faces add no visible detail
+
+    LevelsOfDetail();
+    explicit LevelsOfDetail(const char* i_base_filename, const char* i_source_filename = nullptr);
+
+    bool IsOpen() const; // level 0 exists
+    std::size_t GetLevelsCount() const;
+    Level const& GetLevel(std::size_t i_level) const;
+
+    // Coarsest level with at least one face per i_pixels_per_face pixels of the
+    // projected bounding box (world -> screen transform, the one of Canvas::DrawMesh),
+    // unclipped so a partly visible mesh keeps its detail. Level 0 if the box crosses
+    // the camera plane, the last one if it lies entirely outside i_width x i_height.
+    std::size_t SelectLevel(Transform const& i_transform, int i_width, int i_height,
+                            double i_pixels_per_face = DefaultPixelsPerFace) const;
+
+    static std::string GetLevelFilename(const char* i_base_filename, std::size_t i_level);
+
+  private:
+    std::vector<Level> m_levels;
+    float m_min[3];
+    float m_max[3];
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteLevelsOfDetail // function declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Writes i_mesh as level 0 and then every next level with i_faces_ratio of the
+// faces of the previous one (0.25 halves the resolution on both screen axes),
+// simplified by SimplifyMesh() and reordered by OptimizeFaceOrder(). Stops at
+// i_min_faces_count faces, i_max_levels_count levels or when the simplification
+// stalls. Every level is stamped with i_source_filename. Levels of an older,
+// longer chain are deleted. Level 0 is removed first and written last, so the
+// chain can't be opened until every level is in place.
+template<typename TMesh>
+bool WriteLevelsOfDetail(TMesh const& i_mesh, const char* i_base_filename, const char* i_source_filename = nullptr,
+                         double i_faces_ratio = 0.25, std::size_t i_min_faces_count = 64, std::size_t i_max_levels_count = 8);
+
+
+///////////////////////////////////////////////////////////////////////////////
+// LevelsOfDetail // class definition //
+///////////////////////////////////////////////////////////////////////////////
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+LevelsOfDetail<TVertexType, TTextureType, TNormalType>::LevelsOfDetail()
+  : m_min{0.f, 0.f, 0.f}
+  , m_max{0.f, 0.f, 0.f}
+  {
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+LevelsOfDetail<TVertexType, TTextureType, TNormalType>::LevelsOfDetail(const char* i_base_filename, const char* i_source_filename)
+  : LevelsOfDetail()
+  {
+  for(;;)
+    {
+    Level level(GetLevelFilename(i_base_filename, m_levels.size()).c_str(), i_source_filename);
+    if(!level.IsOpen())
+      break;
+    m_levels.push_back(std::move(level));
+    }
+  if(m_levels.empty())
+    return;
+
+  // Simplification never moves positions, so level 0 bounds hold for all levels
+  auto const& vertices = m_levels[0].vertices();
+  for(std::size_t k = 0; k < 3; ++k)
+    {
+    m_min[k] = vertices.empty() ? 0.f : std::numeric_limits<float>::max();
+    m_max[k] = vertices.empty() ? 0.f : -std::numeric_limits<float>::max();
+    }
+  for(auto const& vertex : vertices)
+    for(std::size_t k = 0; k < 3; ++k)
+      {
+      m_min[k] = std::min(m_min[k], static_cast<float>(vertex[k]));
+      m_max[k] = std::max(m_max[k], static_cast<float>(vertex[k]));
+      }
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+bool
+LevelsOfDetail<TVertexType, TTextureType, TNormalType>::IsOpen() const
+  {
+  return !m_levels.empty();
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+std::size_t
+LevelsOfDetail<TVertexType, TTextureType, TNormalType>::GetLevelsCount() const
+  {
+  return m_levels.size();
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+typename LevelsOfDetail<TVertexType, TTextureType, TNormalType>::Level const&
+LevelsOfDetail<TVertexType, TTextureType, TNormalType>::GetLevel(std::size_t i_level) const
+  {
+  return m_levels[i_level];
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+std::size_t
+LevelsOfDetail<TVertexType, TTextureType, TNormalType>::SelectLevel(Transform const& i_transform, int i_width, int i_height,
+                                                                    double i_pixels_per_face) const
+  {
+  if(m_levels.size() <= 1)
+    return 0;
+
+  double min_x = 0.0, max_x = 0.0, min_y = 0.0, max_y = 0.0;
+  for(int corner = 0; corner < 8; ++corner)
+    {
+    float const point[3] = {(corner & 1) ? m_max[0] : m_min[0], (corner & 2) ? m_max[1] : m_min[1], (corner & 4) ? m_max[2] : m_min[2]};
+    double transformed[4];
+    for(DimensionType row = 0; row < 4; ++row)
+      transformed[row] = static_cast<double>(i_transform(row, 0)) * point[0] + static_cast<double>(i_transform(row, 1)) * point[1]
+                       + static_cast<double>(i_transform(row, 2)) * point[2] + i_transform(row, 3);
+    if(transformed[3] <= 0.0)
+      return 0;
+    double const x = transformed[0] / transformed[3];
+    double const y = transformed[1] / transformed[3];
+    min_x = corner == 0 ? x : std::min(min_x, x);
+    max_x = corner == 0 ? x : std::max(max_x, x);
+    min_y = corner == 0 ? y : std::min(min_y, y);
+    max_y = corner == 0 ? y : std::max(max_y, y);
+    }
+  bool const is_off_screen = max_x <= 0.0 || min_x >= i_width || max_y <= 0.0 || min_y >= i_height;
+  if(is_off_screen)
+    return m_levels.size() - 1;
+
+  // Face counts are of the whole mesh, so they are compared with the whole projected box:
+  // clipping it would pick coarser levels the closer the camera gets
+  double const needed_faces_count = (max_x - min_x) * (max_y - min_y) / i_pixels_per_face;
+  std::size_t level = 0;
+  while(level + 1 < m_levels.size() && static_cast<double>(m_levels[level + 1].faces().size()) >= needed_faces_count)
+    ++level;
+  return level;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+std::string
+LevelsOfDetail<TVertexType, TTextureType, TNormalType>::GetLevelFilename(const char* i_base_filename, std::size_t i_level)
+  {
+  return std::string(i_base_filename) + ".lod" + std::to_string(i_level) + ".mesh";
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteLevelsOfDetail // function definition //
+///////////////////////////////////////////////////////////////////////////////
+template<typename TMesh>
+bool WriteLevelsOfDetail(TMesh const& i_mesh, const char* i_base_filename, const char* i_source_filename,
+                         double i_faces_ratio, std::size_t i_min_faces_count, std::size_t i_max_levels_count)
+  {
+  using Chain = LevelsOfDetail<typename TMesh::VertexType, typename TMesh::TextureType, typename TMesh::NormalType>;
+  using SimplifiedMesh = Mesh<typename TMesh::VertexType, typename TMesh::TextureType, typename TMesh::NormalType>;
+
+  std::string const first_level_filename = Chain::GetLevelFilename(i_base_filename, 0);
+  std::remove(first_level_filename.c_str());
+
+  // Every level is simplified from the previous one, which is the fastest
+  std::vector<SimplifiedMesh> levels;
+  std::size_t faces_count = i_mesh.faces().size();
+  while(levels.size() + 1 < i_max_levels_count)
+    {
+    std::size_t const target_faces_count = static_cast<std::size_t>(faces_count * i_faces_ratio);
+    if(target_faces_count < i_min_faces_count)
+      break;
+    if(levels.empty())
+      levels.push_back(SimplifyMesh(i_mesh, target_faces_count));
+    else
+      levels.push_back(SimplifyMesh(levels.back(), target_faces_count));
+    if(levels.back().faces().size() >= faces_count)
+      {
+      levels.pop_back(); // nothing more can collapse
+      break;
+      }
+    faces_count = levels.back().faces().size();
+    OptimizeFaceOrder(levels.back());
+    if(!WriteMeshCache(levels.back(), Chain::GetLevelFilename(i_base_filename, levels.size()).c_str(), i_source_filename))
+      return false;
+    }
+
+  for(std::size_t level = levels.size() + 1; ; ++level)
+    if(std::remove(Chain::GetLevelFilename(i_base_filename, level).c_str()) != 0)
+      break;
+  return WriteMeshCache(i_mesh, first_level_filename.c_str(), i_source_filename);
+  }
+
+
+} // namespace Geometry
@@ -52,11 +52,51 @@ class LinearInterpolationIterator
 
   private:
     // nested classes
-    struct _Impl;
+    // State is stored inline (no heap allocation), so the iterator might live in registers
+    struct _Impl
+      {
+      // This class is nested and private at the same time, so might not care about access-right
+
+      // methods
+      _Impl(PointType const& i_pt_from, PointType const& i_pt_to);
+      template<DimensionType N>
+      PointIndexType<N> Get() const;
+      template<DimensionType N>
+      AcrossIndexType<N> GetAcrossCoord(PointType const& i_point) const;
+      AlongType GetAlongCoord(PointType const& i_point) const;
+
+      // nested classes
+      template<DimensionType N>
+      struct _CurrentPointItem;
+      template<DimensionType N>
+      struct _PointAcrossItem;
+
+      template<typename T>
+      struct _IntegralDirection;
+      template<typename T>
+      struct _FloatingPointDirection;
+      template<typename T, bool IsFloaingPoint>
+      struct _DirectionTypeQualifier;
+      template<typename T>
+      struct _AcrossData;
+
+      // data
+      typename _AcrossData<AcrossType>::Type m_across_data;
+
+      PointType const m_pt_from;
+      PointType const m_pt_to;
+
+      // TODO : remove it, in case all across directions are Floating Point. For instance, use std::tuple<>
+      AlongType m_along_fractional_half_step; // indicate excess of fractional part => need to shift m_across
+      AlongType m_along_fractional_step;      // value for change m_fractional_counter on each shift m_across
+
+      AlongType m_along;
+      };
+
     struct _RecursiveImpl;
 
     // data
-    std::unique_ptr<_Impl> mp_impl;
+    _Impl m_impl;
   };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -65,13 +105,13 @@ class LinearInterpolationIterator
 template<typename TPointType, DimensionType NDirection>
 LinearInterpolationIterator<TPointType, NDirection>
 ::LinearInterpolationIterator(PointType const& i_pt_from, PointType const& i_pt_to)
-  : mp_impl(std::make_unique<_Impl>(i_pt_from, i_pt_to))
+  : m_impl(i_pt_from, i_pt_to)
   {
-  auto d_along = mp_impl->GetAlongCoord(i_pt_to) - mp_impl->GetAlongCoord(i_pt_from);
+  auto d_along = m_impl.GetAlongCoord(i_pt_to) - m_impl.GetAlongCoord(i_pt_from);
   if(d_along == 0)
     return;
 
-  _RecursiveImpl::Initialise<AcrossDimension>(*mp_impl, d_along);
+  _RecursiveImpl::Initialise<AcrossDimension>(m_impl, d_along);
   }
 
 //-----------------------------------------------------------------------------
@@ -79,7 +119,7 @@ template<typename TPointType, DimensionType NDirection>
 void
 LinearInterpolationIterator<TPointType, NDirection>::GoToBegin()
   {
-  _RecursiveImpl::ResetIteratorToPoint<AcrossDimension>(*mp_impl, mp_impl->m_pt_from);
+  _RecursiveImpl::ResetIteratorToPoint<AcrossDimension>(m_impl, m_impl.m_pt_from);
   }
 
 //-----------------------------------------------------------------------------
@@ -87,7 +127,7 @@ template<typename TPointType, DimensionType NDirection>
 void
 LinearInterpolationIterator<TPointType, NDirection>::GoToEnd()
   {
-  _RecursiveImpl::ResetIteratorToPoint<AcrossDimension>(*mp_impl, mp_impl->m_pt_to);
+  _RecursiveImpl::ResetIteratorToPoint<AcrossDimension>(m_impl, m_impl.m_pt_to);
   }
 
 //-----------------------------------------------------------------------------
@@ -95,7 +135,7 @@ template<typename TPointType, DimensionType NDirection>
 bool
 LinearInterpolationIterator<TPointType, NDirection>::IsAtBegin() const
   {
-  return mp_impl->m_along == mp_impl->GetAlongCoord(mp_impl->m_pt_from);
+  return m_impl.m_along == m_impl.GetAlongCoord(m_impl.m_pt_from);
   }
 
 //-----------------------------------------------------------------------------
@@ -103,7 +143,7 @@ template<typename TPointType, DimensionType NDirection>
 bool
 LinearInterpolationIterator<TPointType, NDirection>::IsAtEnd() const
   {
-  return mp_impl->m_along == mp_impl->GetAlongCoord(mp_impl->m_pt_to);
+  return m_impl.m_along == m_impl.GetAlongCoord(m_impl.m_pt_to);
   }
 
 //-----------------------------------------------------------------------------
@@ -111,7 +151,7 @@ template<typename TPointType, DimensionType NDirection>
 typename LinearInterpolationIterator<TPointType, NDirection>::Self&
 LinearInterpolationIterator<TPointType, NDirection>::operator++()
   {
-  _RecursiveImpl::Increment<AcrossDimension>(*mp_impl);
+  _RecursiveImpl::Increment<AcrossDimension>(m_impl);
 
   return *this;
   }
@@ -121,7 +161,7 @@ template<typename TPointType, DimensionType NDirection>
 typename LinearInterpolationIterator<TPointType, NDirection>::Self&
 LinearInterpolationIterator<TPointType, NDirection>::operator--()
   {
-  _RecursiveImpl::Decrement<AcrossDimension>(*mp_impl);
+  _RecursiveImpl::Decrement<AcrossDimension>(m_impl);
 
   return *this;
   }
@@ -133,7 +173,7 @@ LinearInterpolationIterator<TPointType, NDirection>::operator*() const
   {
   PointType point;
 
-  _RecursiveImpl::FillPoint<Dimension>(*mp_impl, point);
+  _RecursiveImpl::FillPoint<Dimension>(m_impl, point);
 
   return point;
   }
@@ -144,54 +184,10 @@ template<DimensionType N>
 typename LinearInterpolationIterator<TPointType, NDirection>::PointIndexType<N>
 LinearInterpolationIterator<TPointType, NDirection>::Get() const
   {
-  return mp_impl->Get<N>();
+  return m_impl.Get<N>();
   }
 
 
-///////////////////////////////////////////////////////////////////////////////
-// LinearInterpolationIterator::_Impl // struct declaration //
-///////////////////////////////////////////////////////////////////////////////
-template<typename TPointType, DimensionType NDirection>
-struct LinearInterpolationIterator<TPointType, NDirection>::_Impl
-  {
-  // This class is nested and private at the same time, so might not care about access-right
-
-  // methods
-  _Impl(PointType const& i_pt_from, PointType const& i_pt_to);
-  template<DimensionType N>
-  PointIndexType<N> Get() const;
-  template<DimensionType N>
-  AcrossIndexType<N> GetAcrossCoord(PointType const& i_point) const;
-  AlongType GetAlongCoord(PointType const& i_point) const;
-
-  // nested classes
-  template<DimensionType N>
-  struct _CurrentPointItem;
-  template<DimensionType N>
-  struct _PointAcrossItem;
-
-  template<typename T>
-  struct _IntegralDirection;
-  template<typename T>
-  struct _FloatingPointDirection;
-  template<typename T, bool IsFloaingPoint>
-  struct _DirectionTypeQualifier;
-  template<typename T>
-  struct _AcrossData;
-
-  // data
-  typename _AcrossData<AcrossType>::Type m_across_data;
-
-  PointType const m_pt_from;
-  PointType const m_pt_to;
-
-  // TODO : remove it, in case all across directions are Floating Point. For instance, use std::tuple<>
-  AlongType m_along_fractional_half_step; // indicate excess of fractional part => need to shift m_across
-  AlongType m_along_fractional_step;      // value for change m_fractional_counter on each shift m_across
-
-  AlongType m_along;
-  };
-
 ///////////////////////////////////////////////////////////////////////////////
 // LinearInterpolationIterator::_Impl // struct definition //
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,476 @@
+
+#pragma once
+
+#include "./ObjParser.h"
+#include "./../Global/ArrayView.h"
+#include "./../Global/MappedFile.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+
+namespace Geometry {
+
+
+///////////////////////////////////////////////////////////////////////////////
+// MeshCacheHeader // struct declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Binary mesh file: this header followed by vertices, texture coordinates,
+// normals and faces, every array starting at a 64 byte aligned offset.
+// Elements are stored exactly as they are in memory (native byte order), so a
+// mapped file is used without any parsing. Element sizes are recorded to reject
+// files written for different point types, the size and modification time of the
+// source file (an obj usually) to reject files made from an older version of it.
+struct MeshCacheHeader
+  {
+  enum Section
+    {
+    Vertices,
+    Textures,
+    Normals,
+    Faces,
+    SectionsCount
+    };
+
+  static constexpr char Signature[8] = {'A', 'S', 'R', 'M', 'E', 'S', 'H', '\0'};
+  static constexpr std::uint32_t Version = 2;
+  static constexpr std::uint64_t Alignment = 64;
+
+  char m_signature[8];
+  std::uint32_t m_version;
+  std::uint32_t m_element_sizes[SectionsCount];
+  std::uint32_t m_reserved;
+  std::uint64_t m_counts[SectionsCount];
+  std::uint64_t m_offsets[SectionsCount]; // from the beginning of the file
+  std::uint64_t m_source_size;            // zero when written without a source
+  std::int64_t m_source_time;             // std::filesystem::file_time_type ticks
+
+  void Initialize();     // signature and version, everything else zero
+  void ComputeOffsets(); // aligned sections from element sizes and counts
+  bool SetSource(const char* i_source_filename); // false if the source can't be stat'ed
+  bool IsFrom(const char* i_source_filename) const;
+  };
+
+static_assert(sizeof(MeshCacheHeader) % 8 == 0, "MeshCacheHeader must have no trailing padding");
+
+
+///////////////////////////////////////////////////////////////////////////////
+// MappedMesh // class declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Read-only mesh viewing a memory mapped binary file written by WriteMeshCache().
+// Provides the same accessors as Mesh, so it can be drawn the same way; indices
+// are 32-bit. Opening costs a header check only, data are paged in on access.
+// Given i_source_filename, a file not written from its current version is not opened.
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+class MappedMesh
+  {
+  public:
+    using VertexType = TVertexType;
+    using TextureType = TTextureType;
+    using NormalType = TNormalType;
+
+    using Index = std::array<std::uint32_t, 3>;
+    using Face = std::array<Index, 3>; // v, vt, vn
+
+    static_assert(std::is_trivially_copyable<TVertexType>::value && std::is_trivially_copyable<TTextureType>::value
+                  && std::is_trivially_copyable<TNormalType>::value, "Mapped elements must be trivially copyable");
+
+    MappedMesh();
+    explicit MappedMesh(const char* i_filename, const char* i_source_filename = nullptr);
+
+    bool IsOpen() const; // false for missing, truncated, incompatible or stale files
+
+    TVertexType const& vertex(size_t i_idx) const;
+    TTextureType const& texture(size_t i_idx) const;
+    TNormalType const& normal(size_t i_idx) const;
+    Global::ArrayView<TVertexType> const& vertices() const;
+    Global::ArrayView<TTextureType> const& textures() const;
+    Global::ArrayView<TNormalType> const& normals() const;
+    Global::ArrayView<Face> const& faces() const;
+
+  private:
+    template<typename T>
+    static bool _GetArray(Global::MappedFile const& i_file, MeshCacheHeader const& i_header,
+                          MeshCacheHeader::Section i_section, Global::ArrayView<T>& o_view);
+
+    Global::MappedFile m_file;
+    Global::ArrayView<TVertexType>  m_vertices;
+    Global::ArrayView<TTextureType> m_textures;
+    Global::ArrayView<TNormalType>  m_normales;
+    Global::ArrayView<Face>         m_faces;
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteMeshCache // function declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Writes any mesh with Mesh-like accessors in the MappedMesh format, stamped with
+// i_source_filename if given. The file is written under a temporary name and
+// renamed over i_filename once complete, so a failed write never leaves a partial
+// file to be mapped. Returns false if the file can't be written, the source can't
+// be stat'ed or indices don't fit 32 bits.
+template<typename TMesh>
+bool WriteMeshCache(TMesh const& i_mesh, const char* i_filename, const char* i_source_filename = nullptr);
+
+// Converts a Wavefront obj without loading it: after a counting pass the text is
+// parsed in pieces of about i_chunk_size bytes, each appended to its sections,
+// so memory use doesn't depend on the mesh size. The file is stamped with the obj
+// and replaced the same way as by WriteMeshCache().
+// This conversion is the price of streaming an obj: faces index vertices anywhere
+// in the text, which can't be looked up without parsing everything before them,
+// so Canvas::DrawMeshStreamed() draws the binary copy. It costs one extra file of
+// 4 bytes per coordinate and 36 bytes per face for float points (70% of the obj
+// text for african_head.obj), twice that while a previous copy is being replaced.
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+bool WriteMeshCacheFromObj(const char* i_obj_filename, const char* i_filename, std::size_t i_chunk_size = 1 << 24);
+
+
+namespace Details {
+
+
+//-----------------------------------------------------------------------------
+// Closes a mesh cache written under i_temporary_filename and moves it over
+// i_filename, or removes it if anything failed
+inline bool _ReplaceMeshCache(std::ofstream& io_file, std::string const& i_temporary_filename, const char* i_filename)
+  {
+  io_file.close();
+  std::error_code error;
+  if(!io_file.fail())
+    std::filesystem::rename(i_temporary_filename, i_filename, error);
+  if(io_file.fail() || error)
+    {
+    std::filesystem::remove(i_temporary_filename, error);
+    return false;
+    }
+  return true;
+  }
+
+
+} // namespace Details
+
+
+///////////////////////////////////////////////////////////////////////////////
+// MeshCacheHeader // struct definition //
+///////////////////////////////////////////////////////////////////////////////
+inline void
+MeshCacheHeader::Initialize()
+  {
+  *this = MeshCacheHeader();
+  std::memcpy(m_signature, Signature, sizeof(m_signature));
+  m_version = Version;
+  }
+
+//-----------------------------------------------------------------------------
+inline void
+MeshCacheHeader::ComputeOffsets()
+  {
+  std::uint64_t offset = sizeof(MeshCacheHeader);
+  for(int i = 0; i < SectionsCount; ++i)
+    {
+    offset = (offset + Alignment - 1) / Alignment * Alignment;
+    m_offsets[i] = offset;
+    offset += m_counts[i] * m_element_sizes[i];
+    }
+  }
+
+//-----------------------------------------------------------------------------
+inline bool
+MeshCacheHeader::SetSource(const char* i_source_filename)
+  {
+  std::error_code error;
+  std::uintmax_t const size = std::filesystem::file_size(i_source_filename, error);
+  if(error)
+    return false;
+  std::filesystem::file_time_type const time = std::filesystem::last_write_time(i_source_filename, error);
+  if(error)
+    return false;
+  m_source_size = static_cast<std::uint64_t>(size);
+  m_source_time = static_cast<std::int64_t>(time.time_since_epoch().count());
+  return true;
+  }
+
+//-----------------------------------------------------------------------------
+inline bool
+MeshCacheHeader::IsFrom(const char* i_source_filename) const
+  {
+  MeshCacheHeader current = {};
+  return current.SetSource(i_source_filename) && current.m_source_size == m_source_size
+           && current.m_source_time == m_source_time;
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// MappedMesh // class definition //
+///////////////////////////////////////////////////////////////////////////////
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+MappedMesh<TVertexType, TTextureType, TNormalType>::MappedMesh()
+  : m_file()
+  {
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+MappedMesh<TVertexType, TTextureType, TNormalType>::MappedMesh(const char* i_filename, const char* i_source_filename)
+  : m_file(i_filename)
+  {
+  MeshCacheHeader header = {};
+  bool is_valid = m_file.GetSize() >= sizeof(header);
+  if(is_valid)
+    std::memcpy(&header, m_file.GetBegin(), sizeof(header));
+  is_valid = is_valid && std::memcmp(header.m_signature, MeshCacheHeader::Signature, sizeof(header.m_signature)) == 0
+               && header.m_version == MeshCacheHeader::Version;
+  is_valid = is_valid && (i_source_filename == nullptr || header.IsFrom(i_source_filename));
+  is_valid = is_valid && _GetArray(m_file, header, MeshCacheHeader::Vertices, m_vertices);
+  is_valid = is_valid && _GetArray(m_file, header, MeshCacheHeader::Textures, m_textures);
+  is_valid = is_valid && _GetArray(m_file, header, MeshCacheHeader::Normals, m_normales);
+  is_valid = is_valid && _GetArray(m_file, header, MeshCacheHeader::Faces, m_faces);
+  if(!is_valid)
+    *this = MappedMesh();
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+template<typename T>
+bool
+MappedMesh<TVertexType, TTextureType, TNormalType>::_GetArray(Global::MappedFile const& i_file, MeshCacheHeader const& i_header,
+                                                              MeshCacheHeader::Section i_section, Global::ArrayView<T>& o_view)
+  {
+  std::uint64_t const count = i_header.m_counts[i_section];
+  std::uint64_t const offset = i_header.m_offsets[i_section];
+  std::uint64_t const file_size = i_file.GetSize();
+  if(i_header.m_element_sizes[i_section] != sizeof(T) || offset % MeshCacheHeader::Alignment != 0 || offset > file_size
+     || count > (file_size - offset) / sizeof(T))
+    return false;
+  o_view = Global::ArrayView<T>(reinterpret_cast<T const*>(i_file.GetBegin() + offset), static_cast<std::size_t>(count));
+  return true;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+bool
+MappedMesh<TVertexType, TTextureType, TNormalType>::IsOpen() const
+  {
+  return m_file.IsOpen();
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+TVertexType const&
+MappedMesh<TVertexType, TTextureType, TNormalType>::vertex(size_t i_idx) const
+  {
+  return m_vertices[i_idx];
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+TTextureType const&
+MappedMesh<TVertexType, TTextureType, TNormalType>::texture(size_t i_idx) const
+  {
+  return m_textures[i_idx];
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+TNormalType const&
+MappedMesh<TVertexType, TTextureType, TNormalType>::normal(size_t i_idx) const
+  {
+  return m_normales[i_idx];
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+Global::ArrayView<TVertexType> const&
+MappedMesh<TVertexType, TTextureType, TNormalType>::vertices() const
+  {
+  return m_vertices;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+Global::ArrayView<TTextureType> const&
+MappedMesh<TVertexType, TTextureType, TNormalType>::textures() const
+  {
+  return m_textures;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+Global::ArrayView<TNormalType> const&
+MappedMesh<TVertexType, TTextureType, TNormalType>::normals() const
+  {
+  return m_normales;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+Global::ArrayView<typename MappedMesh<TVertexType, TTextureType, TNormalType>::Face> const&
+MappedMesh<TVertexType, TTextureType, TNormalType>::faces() const
+  {
+  return m_faces;
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteMeshCache // function definition //
+///////////////////////////////////////////////////////////////////////////////
+template<typename TMesh>
+bool WriteMeshCache(TMesh const& i_mesh, const char* i_filename, const char* i_source_filename)
+  {
+  using MappedMeshType = MappedMesh<typename TMesh::VertexType, typename TMesh::TextureType, typename TMesh::NormalType>;
+  using Face = typename MappedMeshType::Face;
+
+  auto const& vertices = i_mesh.vertices();
+  auto const& textures = i_mesh.textures();
+  auto const& normals = i_mesh.normals();
+  auto const& faces = i_mesh.faces();
+
+  std::uint64_t const max_index = std::numeric_limits<std::uint32_t>::max();
+  if(vertices.size() > max_index || textures.size() > max_index || normals.size() > max_index)
+    return false;
+
+  std::vector<Face> packed_faces(faces.size());
+  for(std::size_t i = 0; i < faces.size(); ++i)
+    {
+    auto const& face = faces[i];
+    for(std::size_t j = 0; j < 3; ++j)
+      {
+      packed_faces[i][0][j] = static_cast<std::uint32_t>(std::get<0>(face)[j]);
+      packed_faces[i][1][j] = static_cast<std::uint32_t>(std::get<1>(face)[j]);
+      packed_faces[i][2][j] = static_cast<std::uint32_t>(std::get<2>(face)[j]);
+      }
+    }
+
+  MeshCacheHeader header;
+  header.Initialize();
+  if(i_source_filename != nullptr && !header.SetSource(i_source_filename))
+    return false;
+  char const* const sections[MeshCacheHeader::SectionsCount] = {
+    reinterpret_cast<char const*>(vertices.data()), reinterpret_cast<char const*>(textures.data()),
+    reinterpret_cast<char const*>(normals.data()), reinterpret_cast<char const*>(packed_faces.data())};
+  header.m_element_sizes[MeshCacheHeader::Vertices] = sizeof(vertices[0]);
+  header.m_element_sizes[MeshCacheHeader::Textures] = sizeof(textures[0]);
+  header.m_element_sizes[MeshCacheHeader::Normals] = sizeof(normals[0]);
+  header.m_element_sizes[MeshCacheHeader::Faces] = sizeof(Face);
+  header.m_counts[MeshCacheHeader::Vertices] = vertices.size();
+  header.m_counts[MeshCacheHeader::Textures] = textures.size();
+  header.m_counts[MeshCacheHeader::Normals] = normals.size();
+  header.m_counts[MeshCacheHeader::Faces] = packed_faces.size();
+  header.ComputeOffsets();
+
+  std::string const temporary_filename = std::string(i_filename) + ".tmp";
+  std::ofstream file(temporary_filename, std::ios::binary | std::ios::trunc);
+  if(file.fail())
+    return false;
+  file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+  std::uint64_t position = sizeof(header);
+  char const padding[MeshCacheHeader::Alignment] = {};
+  for(int i = 0; i < MeshCacheHeader::SectionsCount; ++i)
+    {
+    file.write(padding, static_cast<std::streamsize>(header.m_offsets[i] - position));
+    std::uint64_t const size = header.m_counts[i] * header.m_element_sizes[i];
+    if(size != 0)
+      file.write(sections[i], static_cast<std::streamsize>(size));
+    position = header.m_offsets[i] + size;
+    }
+  return Details::_ReplaceMeshCache(file, temporary_filename, i_filename);
+  }
+
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType>
+bool WriteMeshCacheFromObj(const char* i_obj_filename, const char* i_filename, std::size_t i_chunk_size)
+  {
+  using MappedMeshType = MappedMesh<TVertexType, TTextureType, TNormalType>;
+  using Parser = ObjParser<MappedMeshType>; // parses straight into the packed 32-bit faces
+  using Face = typename MappedMeshType::Face;
+
+  Global::MappedFile obj_file(i_obj_filename);
+  if(!obj_file.IsOpen())
+    return false;
+  char const* const p_begin = obj_file.GetBegin();
+  char const* const p_end = obj_file.GetEnd();
+
+  typename Parser::Counts const counts = Parser::Count(p_begin, p_end);
+  std::uint64_t const max_index = std::numeric_limits<std::uint32_t>::max();
+  if(counts.m_vertices > max_index || counts.m_textures > max_index || counts.m_normals > max_index)
+    return false;
+
+  MeshCacheHeader header;
+  header.Initialize();
+  if(!header.SetSource(i_obj_filename))
+    return false;
+  header.m_element_sizes[MeshCacheHeader::Vertices] = sizeof(TVertexType);
+  header.m_element_sizes[MeshCacheHeader::Textures] = sizeof(TTextureType);
+  header.m_element_sizes[MeshCacheHeader::Normals] = sizeof(TNormalType);
+  header.m_element_sizes[MeshCacheHeader::Faces] = sizeof(Face);
+  header.m_counts[MeshCacheHeader::Vertices] = counts.m_vertices;
+  header.m_counts[MeshCacheHeader::Textures] = counts.m_textures;
+  header.m_counts[MeshCacheHeader::Normals] = counts.m_normals;
+  header.m_counts[MeshCacheHeader::Faces] = counts.m_faces;
+  header.ComputeOffsets();
+
+  std::string const temporary_filename = std::string(i_filename) + ".tmp";
+  std::ofstream file(temporary_filename, std::ios::binary | std::ios::trunc);
+  if(file.fail())
+    return false;
+  file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+  // Buffers live across chunks, so they grow to one chunk worth at most
+  std::vector<TVertexType> vertices;
+  std::vector<TTextureType> textures;
+  std::vector<TNormalType> normals;
+  std::vector<Face> faces;
+  std::uint64_t written[MeshCacheHeader::SectionsCount] = {};
+  auto const append = [&](MeshCacheHeader::Section i_section, auto const& i_elements)
+    {
+    if(i_elements.empty())
+      return;
+    file.seekp(static_cast<std::streamoff>(header.m_offsets[i_section] + written[i_section] * header.m_element_sizes[i_section]));
+    file.write(reinterpret_cast<char const*>(i_elements.data()), static_cast<std::streamsize>(i_elements.size() * header.m_element_sizes[i_section]));
+    written[i_section] += i_elements.size();
+    };
+  for(char const* p_chunk = p_begin; p_chunk < p_end && !file.fail(); )
+    {
+    char const* p_chunk_end = p_end;
+    if(static_cast<std::size_t>(p_end - p_chunk) > i_chunk_size)
+      {
+      p_chunk_end = std::find(p_chunk + i_chunk_size, p_end, '\n');
+      p_chunk_end = p_chunk_end == p_end ? p_end : p_chunk_end + 1;
+      }
+    typename Parser::Counts const chunk_counts = Parser::Count(p_chunk, p_chunk_end);
+    // Reset, not resized: elements failing to parse must not keep values of the previous chunk
+    vertices.assign(chunk_counts.m_vertices, TVertexType{});
+    textures.assign(chunk_counts.m_textures, TTextureType{});
+    normals.assign(chunk_counts.m_normals, TNormalType{});
+    faces.assign(chunk_counts.m_faces, Face{});
+    Parser::Parse(p_chunk, p_chunk_end, vertices.data(), textures.data(), normals.data(), faces.data());
+    append(MeshCacheHeader::Vertices, vertices);
+    append(MeshCacheHeader::Textures, textures);
+    append(MeshCacheHeader::Normals, normals);
+    append(MeshCacheHeader::Faces, faces);
+    p_chunk = p_chunk_end;
+    }
+
+  // Alignment padding of the last section, so its end is in the file
+  std::uint64_t const file_size = header.m_offsets[MeshCacheHeader::Faces] + header.m_counts[MeshCacheHeader::Faces] * sizeof(Face);
+  file.seekp(0, std::ios::end);
+  if(static_cast<std::uint64_t>(file.tellp()) < file_size)
+    {
+    char const padding[MeshCacheHeader::Alignment] = {};
+    file.write(padding, static_cast<std::streamsize>(file_size - static_cast<std::uint64_t>(file.tellp())));
+    }
+  return Details::_ReplaceMeshCache(file, temporary_filename, i_filename);
+  }
+
+
+} // namespace Geometry
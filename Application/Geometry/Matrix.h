@@ -130,7 +130,7 @@ Matrix<TValueType, NRowsCount, NColumnsCount>::Set(ConstReference i_value)
   {
   static_assert(NRow < RowsCount, "Wrong Row Number!");
   static_assert(NColumn < ColumnsCount, "Wrong Column Number!");
-  operator[](NRow, NColumn) = i_value;
+  operator()(NRow, NColumn) = i_value;
   }
 
 //-----------------------------------------------------------------------------
@@ -146,7 +146,7 @@ template<typename TValueType, DimensionType NRowsCount, DimensionType NColumnsCo
 typename Matrix<TValueType, NRowsCount, NColumnsCount>::ConstReference
 Matrix<TValueType, NRowsCount, NColumnsCount>::operator()(DimensionType i_row, DimensionType i_column) const
   {
-  return m_data[i_row * NRowsCount + i_column];
+  return m_data[i_row * NColumnsCount + i_column];
   }
 
 //-----------------------------------------------------------------------------
@@ -162,7 +162,7 @@ template<typename TValueType, DimensionType NRowsCount, DimensionType NColumnsCo
 typename Matrix<TValueType, NRowsCount, NColumnsCount>::ConstRawPointer
 Matrix<TValueType, NRowsCount, NColumnsCount>::operator[](DimensionType i_row) const
   {
-  return &m_data[i_row * RowsCount];
+  return &m_data[i_row * ColumnsCount];
   }
 
 //-----------------------------------------------------------------------------
@@ -264,7 +264,7 @@ Matrix<TValueType, NRowsCount, NColumnsCount>::operator*(Matrix<ValueType, Colum
       {
       res(row, column) = 0;
       for(DimensionType inner = 0; inner < ColumnsCount; ++inner)
-        res(row, column) = self(row, inner) * i_matrix(inner, column);
+        res(row, column) += self(row, inner) * i_matrix(inner, column);
       }
   return res;
   }
@@ -352,7 +352,7 @@ Matrix<TValueType, NRowsCount, NColumnsCount>::PreMultiply(Matrix<ValueType, NRo
       {
       res(row, column) = 0;
       for(DimensionType inner = 0; inner < NRowsCount; ++inner)
-        res(row, column) = i_matrix(row, inner) * self(inner, column);
+        res(row, column) += i_matrix(row, inner) * self(inner, column);
       }
   return res;
   }
@@ -445,4 +445,7 @@ Matrix<TValueType, NRowsCount, NColumnsCount>::MakeIdentity()
   }
 
 
+static_assert(std::is_trivially_copyable<Matrix<float, 4, 4>>::value, "Matrix is expected to be trivially copyable");
+
+
 } // namespace Geometry
@@ -1,10 +1,17 @@
 
 #pragma once
 
+#include "./ObjParser.h"
+#include "./../Global/MappedFile.h"
+#include "./../Global/ParallelFor.h"
+
+#include <algorithm>
 #include <array>
+#include <cstdint>
+#include <limits>
 #include <vector>
-#include <fstream>
-#include <cassert>
+#include <tuple>
+#include <iostream>
 
 
 namespace Geometry {
@@ -13,132 +20,307 @@ namespace Geometry {
 ///////////////////////////////////////////////////////////////////////////////
 // Mesh // class declaration //
 ///////////////////////////////////////////////////////////////////////////////
-template<typename TVertexType, typename TTextureType, typename TNormalType>
+// TIndexValueType is the integer type faces are stored with; VisitObjMesh()
+// picks the narrowest one fitting a particular file.
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType = std::uint32_t>
 class Mesh
   {
   public:
-    using Index = std::array<std::size_t, 3>;
+    using VertexType = TVertexType;
+    using TextureType = TTextureType;
+    using NormalType = TNormalType;
+
+    using IndexValueType = TIndexValueType;
+    using Index = std::array<TIndexValueType, 3>;
     using Face = std::tuple<Index, Index, Index>; // v, vt, vn
 
-    Mesh(const char* i_filename);
+    Mesh(const char* i_filename, std::size_t i_threads_count = 0); // Wavefront obj, 0 threads - all hardware ones
+    Mesh(ObjLayout const& i_layout, std::size_t i_threads_count = 0); // obj text already split by ObjParser::Split
+    Mesh(std::vector<TVertexType>&& i_vertices, std::vector<TTextureType>&& i_textures,
+         std::vector<TNormalType>&& i_normales, std::vector<Face>&& i_faces);
     Mesh(Mesh&& i_rhs);
 
     TVertexType const& vertex(size_t i_idx) const;
     TTextureType const& texture(size_t i_idx) const;
     TNormalType const& normal(size_t i_idx) const;
+    std::vector<TVertexType> const& vertices() const;
+    std::vector<TTextureType> const& textures() const;
+    std::vector<TNormalType> const& normals() const;
     std::vector<Face> const& faces() const;
 
+    void ReorderFaces(std::vector<std::size_t> const& i_order); // i_order[new position] = old face index
+
+    // Optional per-face data of static meshes, computed once instead of on every draw:
+    // Canvas::DrawMesh and BuildMeshlets take the normals, BoundingVolumeHierarchy the bounds
+    struct FaceBounds
+      {
+      TVertexType m_min;
+      TVertexType m_max;
+      };
+    void PrecomputeFaceData(std::size_t i_threads_count = 0);
+    bool HasFaceData() const;
+    std::vector<TNormalType> const& face_normals() const; // unit, counter-clockwise winding is the front
+    std::vector<FaceBounds> const& face_bounds() const; // world space, axis aligned
+
   private:
+    void _Load(ObjLayout const& i_layout, std::size_t i_threads_count);
+
     std::vector<TVertexType>  m_vertices;
     std::vector<TTextureType> m_textures;
     std::vector<TNormalType>  m_normales;
     std::vector<Face>         m_faces;
+    std::vector<TNormalType>  m_face_normals;
+    std::vector<FaceBounds>   m_face_bounds;
   };
 
 
 ///////////////////////////////////////////////////////////////////////////////
 // Mesh // class definition //
 ///////////////////////////////////////////////////////////////////////////////
-template<typename TVertexType, typename TTextureType, typename TNormalType>
-Mesh<TVertexType, TTextureType, TNormalType>::Mesh(const char* i_filename)
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
+Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>::Mesh(const char* i_filename, std::size_t i_threads_count)
   {
-  std::ifstream in;
-  in.open(i_filename, std::ifstream::in);
-  if(in.fail())
+  Global::MappedFile file(i_filename);
+  if(!file.IsOpen())
     return;
-  std::string line;
-  char trash;
-  while(!in.eof())
-    {
-    std::getline(in, line);
-    std::istringstream iss(line.c_str());
 
-    if(!line.compare(0, 2, "f "))
-      {
-      iss >> trash;
-      Face face;
-      Index::value_type v_idx, t_idx, n_idx;
-      std::size_t i = 0;
-      while(iss >> v_idx >> trash >> t_idx >> trash >> n_idx)
-        {
-        // in wavefront obj all indices start at 1, not zero
-        std::get<0>(face)[i] = --v_idx;
-        std::get<1>(face)[i] = --t_idx;
-        std::get<2>(face)[i] = --n_idx;
-        ++i;
-        }
-      assert(i == 3);
-      m_faces.emplace_back(std::move(face));
-      }
-    else if(!line.compare(0, 2, "v "))
-      {
-      iss >> trash;
-      TVertexType vertex;
-      for(int i = 0; i < 3; i++)
-        iss >> vertex[i];
-      m_vertices.emplace_back(std::move(vertex));
-      }
-    else if(!line.compare(0, 3, "vt "))
-      {
-      iss >> trash >> trash;
-      TTextureType texture;
-      for(int i = 0; i < 3; i++)
-        iss >> texture[i];
-      m_textures.emplace_back(std::move(texture));
-      }
-    else if(!line.compare(0, 3, "vn "))
-      {
-      iss >> trash >> trash;
-      TNormalType nornal;
-      for(int i = 0; i < 3; i++)
-        iss >> nornal[i];
-      m_normales.emplace_back(std::move(nornal));
-      }
-    }
+  _Load(ObjParser<Mesh>::Split(file.GetBegin(), file.GetEnd(), i_threads_count), i_threads_count);
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
+Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>::Mesh(ObjLayout const& i_layout, std::size_t i_threads_count)
+  {
+  _Load(i_layout, i_threads_count);
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
+void
+Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>::_Load(ObjLayout const& i_layout, std::size_t i_threads_count)
+  {
+  ObjParser<Mesh>::Load(i_layout, m_vertices, m_textures, m_normales, m_faces, i_threads_count);
   std::cerr << " #f = " << m_faces.size() << "; #v = " << m_vertices.size() << "; #vt " << m_textures.size() << "; #vn " << m_normales.size() << std::endl;
   }
 
 //-----------------------------------------------------------------------------
-template<typename TVertexType, typename TTextureType, typename TNormalType>
-Mesh<TVertexType, TTextureType, TNormalType>::Mesh(Mesh&& i_rhs)
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
+Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>::Mesh(std::vector<TVertexType>&& i_vertices, std::vector<TTextureType>&& i_textures,
+                                                   std::vector<TNormalType>&& i_normales, std::vector<Face>&& i_faces)
+  : m_vertices(std::move(i_vertices))
+  , m_textures(std::move(i_textures))
+  , m_normales(std::move(i_normales))
+  , m_faces(std::move(i_faces))
+  {
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
+Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>::Mesh(Mesh&& i_rhs)
   : m_vertices(std::move(i_rhs.m_vertices))
   , m_textures(std::move(i_rhs.m_textures))
   , m_normales(std::move(i_rhs.m_normales))
   , m_faces(std::move(i_rhs.m_faces))
+  , m_face_normals(std::move(i_rhs.m_face_normals))
+  , m_face_bounds(std::move(i_rhs.m_face_bounds))
   {
   }
 
 //-----------------------------------------------------------------------------
-template<typename TVertexType, typename TTextureType, typename TNormalType>
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
 typename TVertexType const&
-Mesh<TVertexType, TTextureType, TNormalType>::vertex(size_t i_idx) const
+Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>::vertex(size_t i_idx) const
   {
   return m_vertices[i_idx];
   }
 
 //-----------------------------------------------------------------------------
-template<typename TVertexType, typename TTextureType, typename TNormalType>
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
 typename TTextureType const&
-Mesh<TVertexType, TTextureType, TNormalType>::texture(size_t i_idx) const
+Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>::texture(size_t i_idx) const
   {
   return m_textures[i_idx];
   }
 
 //-----------------------------------------------------------------------------
-template<typename TVertexType, typename TTextureType, typename TNormalType>
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
 typename TNormalType const&
-Mesh<TVertexType, TTextureType, TNormalType>::normal(size_t i_idx) const
+Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>::normal(size_t i_idx) const
   {
   return m_normales[i_idx];
   }
 
 //-----------------------------------------------------------------------------
-template<typename TVertexType, typename TTextureType, typename TNormalType>
-std::vector<typename Mesh<TVertexType, TTextureType, TNormalType>::Face> const&
-Mesh<TVertexType, TTextureType, TNormalType>::faces() const
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
+std::vector<TVertexType> const&
+Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>::vertices() const
+  {
+  return m_vertices;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
+std::vector<TTextureType> const&
+Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>::textures() const
+  {
+  return m_textures;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
+std::vector<TNormalType> const&
+Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>::normals() const
+  {
+  return m_normales;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
+std::vector<typename Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>::Face> const&
+Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>::faces() const
   {
   return m_faces;
   }
 
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
+void
+Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>::ReorderFaces(std::vector<std::size_t> const& i_order)
+  {
+  std::vector<Face> faces;
+  faces.reserve(i_order.size());
+  for(std::size_t face : i_order)
+    faces.push_back(m_faces[face]);
+  m_faces.swap(faces);
+
+  if(HasFaceData())
+    {
+    std::vector<TNormalType> face_normals;
+    std::vector<FaceBounds> face_bounds;
+    face_normals.reserve(i_order.size());
+    face_bounds.reserve(i_order.size());
+    for(std::size_t face : i_order)
+      {
+      face_normals.push_back(m_face_normals[face]);
+      face_bounds.push_back(m_face_bounds[face]);
+      }
+    m_face_normals.swap(face_normals);
+    m_face_bounds.swap(face_bounds);
+    }
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
+void
+Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>::PrecomputeFaceData(std::size_t i_threads_count)
+  {
+  std::size_t const faces_count = m_faces.size();
+  m_face_normals.resize(faces_count);
+  m_face_bounds.resize(faces_count);
+
+  std::size_t const chunk_size = 1 << 14;
+  Global::ParallelFor((faces_count + chunk_size - 1) / chunk_size, [&](std::size_t i_chunk)
+    {
+    std::size_t const last = std::min((i_chunk + 1) * chunk_size, faces_count);
+    for(std::size_t i = i_chunk * chunk_size; i < last; ++i)
+      {
+      Index const& vertex_indices = std::get<0>(m_faces[i]);
+      TVertexType const& v1 = m_vertices[vertex_indices[0]];
+      TVertexType const& v2 = m_vertices[vertex_indices[1]];
+      TVertexType const& v3 = m_vertices[vertex_indices[2]];
+
+      // The same expression renderers use, so precomputed normals give the same shading
+      TNormalType normal = (v2 - v1) ^ (v3 - v1);
+      normal.Normalise();
+      m_face_normals[i] = normal;
+
+      FaceBounds& bounds = m_face_bounds[i];
+      for(std::size_t axis = 0; axis < 3; ++axis)
+        {
+        bounds.m_min[axis] = std::min(v1[axis], std::min(v2[axis], v3[axis]));
+        bounds.m_max[axis] = std::max(v1[axis], std::max(v2[axis], v3[axis]));
+        }
+      }
+    }, i_threads_count);
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
+bool
+Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>::HasFaceData() const
+  {
+  return !m_faces.empty() && m_face_normals.size() == m_faces.size();
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
+std::vector<TNormalType> const&
+Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>::face_normals() const
+  {
+  return m_face_normals;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
+std::vector<typename Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>::FaceBounds> const&
+Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType>::face_bounds() const
+  {
+  return m_face_bounds;
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// GetPrecomputedFaceNormals // function definition //
+///////////////////////////////////////////////////////////////////////////////
+// Unit face normals of Mesh::PrecomputeFaceData(), nullptr for meshes without them
+template<typename TMesh>
+typename TMesh::NormalType const* GetPrecomputedFaceNormals(TMesh const&)
+  {
+  return nullptr;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename TIndexValueType>
+TNormalType const* GetPrecomputedFaceNormals(Mesh<TVertexType, TTextureType, TNormalType, TIndexValueType> const& i_mesh)
+  {
+  return i_mesh.HasFaceData() ? i_mesh.face_normals().data() : nullptr;
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// VisitObjMesh // function definition //
+///////////////////////////////////////////////////////////////////////////////
+// Loads a Wavefront obj with the narrowest index type its record counts allow
+// (std::uint16_t or std::uint32_t) and passes the mesh to i_visitor, which is
+// usually a generic lambda. Returns false if the file can't be read.
+template<typename TVertexType, typename TTextureType, typename TNormalType, typename FVisitor>
+bool VisitObjMesh(const char* i_filename, FVisitor i_visitor, std::size_t i_threads_count = 0)
+  {
+  using WideMesh = Mesh<TVertexType, TTextureType, TNormalType, std::uint32_t>;
+  using CompactMesh = Mesh<TVertexType, TTextureType, TNormalType, std::uint16_t>;
+
+  // The file is mapped and counted once: the index type is picked from the counts of the
+  // parallel split, which the mesh of that type is then parsed with
+  Global::MappedFile file(i_filename);
+  if(!file.IsOpen())
+    return false;
+  ObjLayout const layout = ObjParser<WideMesh>::Split(file.GetBegin(), file.GetEnd(), i_threads_count);
+
+  // Obj indices are 1-based, the largest one must fit too
+  ObjCounts const& counts = layout.m_total;
+  std::size_t const max_count = std::max(counts.m_vertices, std::max(counts.m_textures, counts.m_normals));
+  if(max_count <= std::numeric_limits<std::uint16_t>::max())
+    {
+    CompactMesh mesh(layout, i_threads_count);
+    i_visitor(mesh);
+    }
+  else
+    {
+    WideMesh mesh(layout, i_threads_count);
+    i_visitor(mesh);
+    }
+  return true;
+  }
+
 
 } // namespace Geometry
@@ -0,0 +1,418 @@
+
+#pragma once
+
+#include "./Mesh.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+
+namespace Geometry {
+
+
+///////////////////////////////////////////////////////////////////////////////
+// MeshSimplifier // struct declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Edge collapse simplification driven by quadric error metrics, as in Garland
+// and Heckbert "Surface simplification using quadric error metrics". Every
+// position accumulates the quadrics of its face planes (area weighted) and of
+// planes through border edges, so outlines are kept too. The cheapest edge is
+// collapsed into one of its ends; the kept position never moves, which keeps
+// texture coordinates and normals of the source valid for the result.
+// Collapses that flip a face or glue two sheets together are skipped.
+struct MeshSimplifier
+  {
+  using Index = std::uint32_t;
+  using Point = std::array<double, 3>;
+
+  static constexpr double BorderWeight = 10.0;   // border planes relative to face planes
+  static constexpr double MinNormalDot = 0.2;    // faces turning farther are flipped
+
+  // Symmetric 4x4 matrix, upper triangle
+  struct Quadric
+    {
+    double m_values[10];
+
+    static Quadric FromPlane(Point const& i_normal, double i_offset, double i_weight);
+    void Add(Quadric const& i_quadric);
+    double GetError(Point const& i_point) const;
+    };
+
+  // i_corners: position, texture and normal indices of 3 corners per face, updated in place;
+  // returns which faces remain
+  static std::vector<unsigned char> Collapse(std::vector<Point> const& i_positions,
+                                             std::vector<std::array<Index, 3>>& io_corners, std::size_t i_target_faces_count);
+
+  private:
+    struct _Collapse
+      {
+      double m_error;
+      Index m_removed;
+      Index m_kept;
+      std::uint32_t m_removed_stamp;
+      std::uint32_t m_kept_stamp;
+
+      bool operator<(_Collapse const& i_other) const; // reversed for the min-heap
+      };
+
+    static void _GetPlane(Point const& i_p0, Point const& i_p1, Point const& i_p2, Point& o_normal, double& o_double_area);
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SimplifyMesh // function declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Returns a copy of the mesh with about i_target_faces_count faces, less if
+// nothing else can collapse. Faces keep the source order, unused vertices,
+// texture coordinates and normals are dropped.
+template<typename TMesh>
+Mesh<typename TMesh::VertexType, typename TMesh::TextureType, typename TMesh::NormalType>
+SimplifyMesh(TMesh const& i_mesh, std::size_t i_target_faces_count);
+
+
+///////////////////////////////////////////////////////////////////////////////
+// MeshSimplifier // struct definition //
+///////////////////////////////////////////////////////////////////////////////
+inline MeshSimplifier::Quadric
+MeshSimplifier::Quadric::FromPlane(Point const& i_normal, double i_offset, double i_weight)
+  {
+  double const plane[4] = {i_normal[0], i_normal[1], i_normal[2], i_offset};
+  Quadric quadric;
+  for(int row = 0, i = 0; row < 4; ++row)
+    for(int column = row; column < 4; ++column, ++i)
+      quadric.m_values[i] = i_weight * plane[row] * plane[column];
+  return quadric;
+  }
+
+//-----------------------------------------------------------------------------
+inline void
+MeshSimplifier::Quadric::Add(Quadric const& i_quadric)
+  {
+  for(int i = 0; i < 10; ++i)
+    m_values[i] += i_quadric.m_values[i];
+  }
+
+//-----------------------------------------------------------------------------
+inline double
+MeshSimplifier::Quadric::GetError(Point const& i_point) const
+  {
+  double const point[4] = {i_point[0], i_point[1], i_point[2], 1.0};
+  double error = 0.0;
+  for(int row = 0, i = 0; row < 4; ++row)
+    for(int column = row; column < 4; ++column, ++i)
+      error += (row == column ? 1.0 : 2.0) * m_values[i] * point[row] * point[column];
+  return std::max(error, 0.0);
+  }
+
+//-----------------------------------------------------------------------------
+inline bool
+MeshSimplifier::_Collapse::operator<(_Collapse const& i_other) const
+  {
+  return m_error > i_other.m_error;
+  }
+
+//-----------------------------------------------------------------------------
+inline void
+MeshSimplifier::_GetPlane(Point const& i_p0, Point const& i_p1, Point const& i_p2, Point& o_normal, double& o_double_area)
+  {
+  double const e1[3] = {i_p1[0] - i_p0[0], i_p1[1] - i_p0[1], i_p1[2] - i_p0[2]};
+  double const e2[3] = {i_p2[0] - i_p0[0], i_p2[1] - i_p0[1], i_p2[2] - i_p0[2]};
+  o_normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+  o_normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+  o_normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+  o_double_area = std::sqrt(o_normal[0] * o_normal[0] + o_normal[1] * o_normal[1] + o_normal[2] * o_normal[2]);
+  for(int k = 0; k < 3; ++k)
+    o_normal[k] = o_double_area > 0.0 ? o_normal[k] / o_double_area : 0.0;
+  }
+
+//-----------------------------------------------------------------------------
+inline std::vector<unsigned char>
+MeshSimplifier::Collapse(std::vector<Point> const& i_positions,
+                         std::vector<std::array<Index, 3>>& io_corners, std::size_t i_target_faces_count)
+  {
+  std::size_t const faces_count = io_corners.size() / 3;
+  std::size_t const vertices_count = i_positions.size();
+  auto const position = [&](Index i_vertex) -> Point const&
+    {
+    return i_positions[i_vertex];
+    };
+
+  std::vector<unsigned char> is_face_alive(faces_count, 1);
+  std::vector<std::vector<Index>> vertex_faces(vertices_count);
+  for(std::size_t face = 0; face < faces_count; ++face)
+    for(std::size_t corner = 0; corner < 3; ++corner)
+      vertex_faces[io_corners[3 * face + corner][0]].push_back(static_cast<Index>(face));
+
+  // Face planes
+  Quadric const zero = {};
+  std::vector<Quadric> quadrics(vertices_count, zero);
+  std::unordered_map<std::uint64_t, std::size_t> edge_faces;
+  auto const edge_key = [](Index i_a, Index i_b)
+    {
+    return (static_cast<std::uint64_t>(std::min(i_a, i_b)) << 32) | std::max(i_a, i_b);
+    };
+  for(std::size_t face = 0; face < faces_count; ++face)
+    {
+    Point normal;
+    double double_area;
+    _GetPlane(position(io_corners[3 * face][0]), position(io_corners[3 * face + 1][0]), position(io_corners[3 * face + 2][0]),
+              normal, double_area);
+    Point const& p0 = position(io_corners[3 * face][0]);
+    Quadric const quadric = Quadric::FromPlane(normal, -(normal[0] * p0[0] + normal[1] * p0[1] + normal[2] * p0[2]), 0.5 * double_area);
+    for(std::size_t corner = 0; corner < 3; ++corner)
+      {
+      quadrics[io_corners[3 * face + corner][0]].Add(quadric);
+      ++edge_faces[edge_key(io_corners[3 * face + corner][0], io_corners[3 * face + (corner + 1) % 3][0])];
+      }
+    }
+
+  // Border edges: plane through the edge, perpendicular to the face
+  for(std::size_t face = 0; face < faces_count; ++face)
+    {
+    Point normal;
+    double double_area;
+    _GetPlane(position(io_corners[3 * face][0]), position(io_corners[3 * face + 1][0]), position(io_corners[3 * face + 2][0]),
+              normal, double_area);
+    for(std::size_t corner = 0; corner < 3; ++corner)
+      {
+      Index const a = io_corners[3 * face + corner][0], b = io_corners[3 * face + (corner + 1) % 3][0];
+      if(edge_faces[edge_key(a, b)] != 1)
+        continue;
+      Point const& pa = position(a);
+      Point const& pb = position(b);
+      double const edge[3] = {pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2]};
+      Point border = {{edge[1] * normal[2] - edge[2] * normal[1], edge[2] * normal[0] - edge[0] * normal[2], edge[0] * normal[1] - edge[1] * normal[0]}};
+      double const length = std::sqrt(border[0] * border[0] + border[1] * border[1] + border[2] * border[2]);
+      if(length == 0.0)
+        continue;
+      for(int k = 0; k < 3; ++k)
+        border[k] /= length;
+      Quadric const quadric = Quadric::FromPlane(border, -(border[0] * pa[0] + border[1] * pa[1] + border[2] * pa[2]), BorderWeight * length * length);
+      quadrics[a].Add(quadric);
+      quadrics[b].Add(quadric);
+      }
+    }
+  edge_faces.clear();
+
+  // Candidates are re-pushed on change, old ones are recognized by vertex stamps
+  std::vector<std::uint32_t> stamps(vertices_count, 0);
+  std::vector<unsigned char> is_vertex_alive(vertices_count, 1);
+  std::priority_queue<_Collapse> collapses;
+  auto const push_edge = [&](Index i_a, Index i_b)
+    {
+    Quadric quadric = quadrics[i_a];
+    quadric.Add(quadrics[i_b]);
+    double const error_to_a = quadric.GetError(position(i_a));
+    double const error_to_b = quadric.GetError(position(i_b));
+    if(error_to_b <= error_to_a)
+      collapses.push({error_to_b, i_a, i_b, stamps[i_a], stamps[i_b]});
+    else
+      collapses.push({error_to_a, i_b, i_a, stamps[i_b], stamps[i_a]});
+    };
+  for(std::size_t face = 0; face < faces_count; ++face)
+    for(std::size_t corner = 0; corner < 3; ++corner)
+      {
+      Index const a = io_corners[3 * face + corner][0], b = io_corners[3 * face + (corner + 1) % 3][0];
+      if(edge_faces.emplace(edge_key(a, b), 0).second)
+        push_edge(a, b);
+      }
+  edge_faces.clear();
+
+  std::vector<Index> neighbours;
+  std::vector<Index> removed_neighbours;
+  std::size_t alive_faces_count = faces_count;
+  while(alive_faces_count > i_target_faces_count && !collapses.empty())
+    {
+    _Collapse const collapse = collapses.top();
+    collapses.pop();
+    Index const removed = collapse.m_removed, kept = collapse.m_kept;
+    if(!is_vertex_alive[removed] || !is_vertex_alive[kept]
+       || stamps[removed] != collapse.m_removed_stamp || stamps[kept] != collapse.m_kept_stamp)
+      continue;
+
+    auto const contains = [&](Index i_face, Index i_vertex)
+      {
+      return io_corners[3 * i_face][0] == i_vertex || io_corners[3 * i_face + 1][0] == i_vertex || io_corners[3 * i_face + 2][0] == i_vertex;
+      };
+
+    // Link condition: the only common neighbours are the opposite corners of the shared faces
+    auto const collect_neighbours = [&](Index i_vertex, std::vector<Index>& o_neighbours)
+      {
+      o_neighbours.clear();
+      for(Index face : vertex_faces[i_vertex])
+        if(is_face_alive[face])
+          for(std::size_t corner = 0; corner < 3; ++corner)
+            if(io_corners[3 * face + corner][0] != i_vertex)
+              o_neighbours.push_back(io_corners[3 * face + corner][0]);
+      std::sort(o_neighbours.begin(), o_neighbours.end());
+      o_neighbours.erase(std::unique(o_neighbours.begin(), o_neighbours.end()), o_neighbours.end());
+      };
+    collect_neighbours(removed, removed_neighbours);
+    collect_neighbours(kept, neighbours);
+    std::size_t shared_faces_count = 0;
+    for(Index face : vertex_faces[removed])
+      shared_faces_count += is_face_alive[face] && contains(face, kept);
+    std::size_t common_count = 0;
+    for(Index neighbour : removed_neighbours)
+      common_count += std::binary_search(neighbours.begin(), neighbours.end(), neighbour);
+    if(shared_faces_count == 0 || common_count != shared_faces_count)
+      continue;
+
+    bool is_flipping = false;
+    for(Index face : vertex_faces[removed])
+      {
+      if(!is_face_alive[face] || contains(face, kept))
+        continue;
+      Point const* corners[3];
+      Point const* moved[3];
+      for(std::size_t corner = 0; corner < 3; ++corner)
+        {
+        Index const vertex = io_corners[3 * face + corner][0];
+        corners[corner] = &position(vertex);
+        moved[corner] = vertex == removed ? &position(kept) : corners[corner];
+        }
+      Point normal, moved_normal;
+      double double_area, moved_double_area;
+      _GetPlane(*corners[0], *corners[1], *corners[2], normal, double_area);
+      _GetPlane(*moved[0], *moved[1], *moved[2], moved_normal, moved_double_area);
+      if(moved_double_area == 0.0 || normal[0] * moved_normal[0] + normal[1] * moved_normal[1] + normal[2] * moved_normal[2] < MinNormalDot)
+        {
+        is_flipping = true;
+        break;
+        }
+      }
+    if(is_flipping)
+      continue;
+
+    // Shared faces vanish; their attributes at the removed corner map to the ones at the kept corner,
+    // so the remaining faces follow the seams
+    std::vector<std::pair<Index, Index>> texture_map, normal_map;
+    for(Index face : vertex_faces[removed])
+      {
+      if(!is_face_alive[face] || !contains(face, kept))
+        continue;
+      std::array<Index, 3> removed_corner = {}, kept_corner = {};
+      for(std::size_t corner = 0; corner < 3; ++corner)
+        {
+        if(io_corners[3 * face + corner][0] == removed)
+          removed_corner = io_corners[3 * face + corner];
+        if(io_corners[3 * face + corner][0] == kept)
+          kept_corner = io_corners[3 * face + corner];
+        }
+      texture_map.emplace_back(removed_corner[1], kept_corner[1]);
+      normal_map.emplace_back(removed_corner[2], kept_corner[2]);
+      is_face_alive[face] = 0;
+      --alive_faces_count;
+      }
+    for(Index face : vertex_faces[removed])
+      {
+      if(!is_face_alive[face])
+        continue;
+      for(std::size_t corner = 0; corner < 3; ++corner)
+        {
+        std::array<Index, 3>& face_corner = io_corners[3 * face + corner];
+        if(face_corner[0] != removed)
+          continue;
+        face_corner[0] = kept;
+        for(auto const& mapping : texture_map)
+          if(face_corner[1] == mapping.first)
+            {
+            face_corner[1] = mapping.second;
+            break;
+            }
+        for(auto const& mapping : normal_map)
+          if(face_corner[2] == mapping.first)
+            {
+            face_corner[2] = mapping.second;
+            break;
+            }
+        }
+      vertex_faces[kept].push_back(face);
+      }
+
+    is_vertex_alive[removed] = 0;
+    std::vector<Index>().swap(vertex_faces[removed]);
+    auto& kept_faces = vertex_faces[kept];
+    kept_faces.erase(std::remove_if(kept_faces.begin(), kept_faces.end(), [&](Index i_face) { return !is_face_alive[i_face]; }), kept_faces.end());
+    quadrics[kept].Add(quadrics[removed]);
+    ++stamps[kept];
+    collect_neighbours(kept, neighbours);
+    for(Index neighbour : neighbours)
+      push_edge(kept, neighbour);
+    }
+
+  return is_face_alive;
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SimplifyMesh // function definition //
+///////////////////////////////////////////////////////////////////////////////
+template<typename TMesh>
+Mesh<typename TMesh::VertexType, typename TMesh::TextureType, typename TMesh::NormalType>
+SimplifyMesh(TMesh const& i_mesh, std::size_t i_target_faces_count)
+  {
+  using Result = Mesh<typename TMesh::VertexType, typename TMesh::TextureType, typename TMesh::NormalType>;
+  using Index = MeshSimplifier::Index;
+
+  auto const& vertices = i_mesh.vertices();
+  auto const& faces = i_mesh.faces();
+  std::vector<MeshSimplifier::Point> positions(vertices.size());
+  for(std::size_t i = 0; i < vertices.size(); ++i)
+    for(std::size_t k = 0; k < 3; ++k)
+      positions[i][k] = vertices[i][k];
+  std::vector<std::array<Index, 3>> corners(3 * faces.size());
+  for(std::size_t face = 0; face < faces.size(); ++face)
+    for(std::size_t corner = 0; corner < 3; ++corner)
+      corners[3 * face + corner] = {{static_cast<Index>(std::get<0>(faces[face])[corner]),
+                                     static_cast<Index>(std::get<1>(faces[face])[corner]),
+                                     static_cast<Index>(std::get<2>(faces[face])[corner])}};
+
+  std::vector<unsigned char> const is_face_alive = MeshSimplifier::Collapse(positions, corners, i_target_faces_count);
+
+  // Compact every attribute array to the used elements, numbered by first use
+  std::vector<typename TMesh::VertexType> result_vertices;
+  std::vector<typename TMesh::TextureType> result_textures;
+  std::vector<typename TMesh::NormalType> result_normals;
+  std::vector<typename Result::Face> result_faces;
+  std::vector<Index> remaps[3] = {std::vector<Index>(vertices.size(), std::numeric_limits<Index>::max()),
+                                  std::vector<Index>(i_mesh.textures().size(), std::numeric_limits<Index>::max()),
+                                  std::vector<Index>(i_mesh.normals().size(), std::numeric_limits<Index>::max())};
+  auto const remap = [&](std::size_t i_array, Index i_index, auto const& i_source, auto& io_result) -> typename Result::IndexValueType
+    {
+    if(i_index >= remaps[i_array].size())
+      return i_index; // faces of meshes without texture coordinates or normals still refer to them
+    if(remaps[i_array][i_index] == std::numeric_limits<Index>::max())
+      {
+      remaps[i_array][i_index] = static_cast<Index>(io_result.size());
+      io_result.push_back(i_source[i_index]);
+      }
+    return remaps[i_array][i_index];
+    };
+  for(std::size_t face = 0; face < faces.size(); ++face)
+    {
+    if(!is_face_alive[face])
+      continue;
+    typename Result::Face result_face;
+    for(std::size_t corner = 0; corner < 3; ++corner)
+      {
+      std::array<Index, 3> const& source = corners[3 * face + corner];
+      std::get<0>(result_face)[corner] = remap(0, source[0], vertices, result_vertices);
+      std::get<1>(result_face)[corner] = remap(1, source[1], i_mesh.textures(), result_textures);
+      std::get<2>(result_face)[corner] = remap(2, source[2], i_mesh.normals(), result_normals);
+      }
+    result_faces.push_back(result_face);
+    }
+  return Result(std::move(result_vertices), std::move(result_textures), std::move(result_normals), std::move(result_faces));
+  }
+
+
+} // namespace Geometry
@@ -0,0 +1,285 @@
+
+#pragma once
+
+#include "./HomogeneousCrossProduct.h"
+#include "./Matrix.h"
+#include "./Mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace Geometry {
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Meshlet // struct declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Cluster of faces [m_first_face, m_first_face + m_faces_count) of a mesh with
+// the bounds used to reject all of them at once:
+//  - bounding box and sphere of the vertices,
+//  - normal cone: every unit face normal n has dot(n, m_cone_axis) >= cos of the
+//    cone half angle; m_cone_cutoff is the sine of it, > 1 if the cone is too wide.
+struct Meshlet
+  {
+  std::uint32_t m_first_face;
+  std::uint32_t m_faces_count;
+  float m_min[3];
+  float m_max[3];
+  float m_center[3];
+  float m_radius;
+  float m_cone_axis[3];
+  float m_cone_cutoff;
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// BuildMeshlets // function declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Splits the mesh into clusters of up to i_max_faces faces grown over shared
+// vertices, taking only faces within acos(i_min_normal_dot) of the first face
+// so that normal cones stay narrow. Faces are reordered to make every cluster
+// a contiguous range.
+template<typename TMesh>
+std::vector<Meshlet> BuildMeshlets(TMesh& io_mesh, std::size_t i_max_faces = 64, float i_min_normal_dot = 0.5f);
+
+
+///////////////////////////////////////////////////////////////////////////////
+// MeshletCuller // class declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Cluster tests for one world -> screen transform (the one of Canvas::DrawMesh).
+// Camera is taken from the transform itself: it is the point projected nowhere,
+// the null vector C of x, y and w rows. A face with unit normal n through p is
+// front facing on the screen exactly when dot((n, -dot(n, p)), C) > 0, which is
+// what the cone test is built on, so it agrees with screen winding culling for
+// any projective transform, mirrored or not.
+class MeshletCuller
+  {
+  public:
+    using Transform = Matrix<float, 4, 4>;
+
+    MeshletCuller(Transform const& i_transform, int i_width, int i_height);
+
+    bool IsBackFacing(Meshlet const& i_meshlet) const; // all faces are back facing
+    bool IsOutside(Meshlet const& i_meshlet) const;    // bounding box is in front of the camera and off screen
+
+  private:
+    double m_transform[4][4];
+    double m_camera[3];    // eye position, or view direction for a parallel projection
+    double m_front_sign;   // +1 or -1, sign of C.w
+    bool m_is_perspective;
+    int m_width;
+    int m_height;
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// BuildMeshlets // function definition //
+///////////////////////////////////////////////////////////////////////////////
+template<typename TMesh>
+std::vector<Meshlet> BuildMeshlets(TMesh& io_mesh, std::size_t i_max_faces, float i_min_normal_dot)
+  {
+  auto const& faces = io_mesh.faces();
+  auto const& vertices = io_mesh.vertices();
+  std::size_t const faces_count = faces.size();
+  std::size_t const vertices_count = vertices.size();
+
+  auto const get_position = [&](std::size_t i_face, std::size_t i_corner) -> typename TMesh::VertexType const&
+    {
+    return vertices[std::get<0>(faces[i_face])[i_corner]];
+    };
+  // Precomputed normals come from the same expression; they stay valid until faces are reordered at the end
+  using NormalType = typename TMesh::NormalType;
+  std::vector<NormalType> computed_face_normals;
+  NormalType const* p_face_normals = GetPrecomputedFaceNormals(io_mesh);
+  if(p_face_normals == nullptr)
+    {
+    computed_face_normals.resize(faces_count);
+    for(std::size_t i = 0; i < faces_count; ++i)
+      {
+      computed_face_normals[i] = (get_position(i, 1) - get_position(i, 0)) ^ (get_position(i, 2) - get_position(i, 0));
+      computed_face_normals[i].Normalise();
+      }
+    p_face_normals = computed_face_normals.data();
+    }
+
+  // Faces of every vertex
+  std::vector<std::size_t> offsets(vertices_count + 1, 0);
+  for(auto const& face : faces)
+    for(std::size_t corner = 0; corner < 3; ++corner)
+      ++offsets[std::get<0>(face)[corner] + 1];
+  for(std::size_t v = 0; v < vertices_count; ++v)
+    offsets[v + 1] += offsets[v];
+  std::vector<std::size_t> vertex_faces(offsets.back());
+  std::vector<std::size_t> filled(offsets.begin(), offsets.end() - 1);
+  for(std::size_t i = 0; i < faces_count; ++i)
+    for(std::size_t corner = 0; corner < 3; ++corner)
+      vertex_faces[filled[std::get<0>(faces[i])[corner]]++] = i;
+
+  std::vector<unsigned char> is_assigned(faces_count, 0);
+  std::vector<std::size_t> order;
+  order.reserve(faces_count);
+  std::vector<Meshlet> meshlets;
+  for(std::size_t seed = 0; seed < faces_count; ++seed)
+    {
+    if(is_assigned[seed])
+      continue;
+
+    // Breadth-first growth keeps clusters compact
+    std::size_t const first = order.size();
+    is_assigned[seed] = 1;
+    order.push_back(seed);
+    for(std::size_t next = first; next < order.size() && order.size() - first < i_max_faces; ++next)
+      {
+      std::size_t const face = order[next];
+      for(std::size_t corner = 0; corner < 3 && order.size() - first < i_max_faces; ++corner)
+        {
+        std::size_t const v = std::get<0>(faces[face])[corner];
+        for(std::size_t i = offsets[v]; i < offsets[v + 1] && order.size() - first < i_max_faces; ++i)
+          {
+          std::size_t const adjacent = vertex_faces[i];
+          if(is_assigned[adjacent] || p_face_normals[adjacent] * p_face_normals[seed] < i_min_normal_dot)
+            continue;
+          is_assigned[adjacent] = 1;
+          order.push_back(adjacent);
+          }
+        }
+      }
+
+    Meshlet meshlet;
+    meshlet.m_first_face = static_cast<std::uint32_t>(first);
+    meshlet.m_faces_count = static_cast<std::uint32_t>(order.size() - first);
+
+    double axis[3] = {0.0, 0.0, 0.0};
+    for(std::size_t k = 0; k < 3; ++k)
+      {
+      meshlet.m_min[k] = meshlet.m_max[k] = get_position(seed, 0)[k];
+      for(std::size_t i = first; i < order.size(); ++i)
+        {
+        axis[k] += p_face_normals[order[i]][k];
+        for(std::size_t corner = 0; corner < 3; ++corner)
+          {
+          meshlet.m_min[k] = std::min(meshlet.m_min[k], static_cast<float>(get_position(order[i], corner)[k]));
+          meshlet.m_max[k] = std::max(meshlet.m_max[k], static_cast<float>(get_position(order[i], corner)[k]));
+          }
+        }
+      meshlet.m_center[k] = 0.5f * (meshlet.m_min[k] + meshlet.m_max[k]);
+      }
+
+    double radius_squared = 0.0;
+    for(std::size_t i = first; i < order.size(); ++i)
+      for(std::size_t corner = 0; corner < 3; ++corner)
+        {
+        double distance_squared = 0.0;
+        for(std::size_t k = 0; k < 3; ++k)
+          {
+          double const delta = get_position(order[i], corner)[k] - meshlet.m_center[k];
+          distance_squared += delta * delta;
+          }
+        radius_squared = std::max(radius_squared, distance_squared);
+        }
+    meshlet.m_radius = static_cast<float>(std::sqrt(radius_squared)) * 1.0001f; // float rounding must not shrink it
+
+    // Average normal as the axis, the widest face decides the angle
+    double const axis_length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    double min_dot = axis_length > 0.0 ? 1.0 : -1.0;
+    for(std::size_t k = 0; k < 3; ++k)
+      axis[k] = axis_length > 0.0 ? axis[k] / axis_length : 0.0;
+    for(std::size_t i = first; i < order.size(); ++i)
+      {
+      auto const& normal = p_face_normals[order[i]];
+      min_dot = std::min(min_dot, axis[0] * normal[0] + axis[1] * normal[1] + axis[2] * normal[2]);
+      }
+    for(std::size_t k = 0; k < 3; ++k)
+      meshlet.m_cone_axis[k] = static_cast<float>(axis[k]);
+    // Small margin for float rounding in the test; 90 degrees and wider cones are never culled
+    meshlet.m_cone_cutoff = min_dot > 0.01 ? static_cast<float>(std::sqrt(1.0 - min_dot * min_dot)) + 1e-3f : 2.f;
+
+    meshlets.push_back(meshlet);
+    }
+
+  io_mesh.ReorderFaces(order);
+  return meshlets;
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// MeshletCuller // class definition //
+///////////////////////////////////////////////////////////////////////////////
+inline
+MeshletCuller::MeshletCuller(Transform const& i_transform, int i_width, int i_height)
+  : m_width(i_width)
+  , m_height(i_height)
+  {
+  for(DimensionType row = 0; row < 4; ++row)
+    for(DimensionType column = 0; column < 4; ++column)
+      m_transform[row][column] = i_transform(row, column);
+
+  double camera[4];
+  GetHomogeneousCrossProduct(m_transform[0], m_transform[1], m_transform[3], camera);
+
+  double const scale = std::max(std::max(std::fabs(camera[0]), std::fabs(camera[1])), std::fabs(camera[2]));
+  m_is_perspective = std::fabs(camera[3]) > 1e-9 * scale;
+  m_front_sign = camera[3] < 0.0 ? -1.0 : 1.0;
+  for(int k = 0; k < 3; ++k)
+    m_camera[k] = m_is_perspective ? camera[k] / camera[3] : -camera[k]; // parallel: back facing iff dot(n, -C) >= 0
+  }
+
+//-----------------------------------------------------------------------------
+inline bool
+MeshletCuller::IsBackFacing(Meshlet const& i_meshlet) const
+  {
+  if(i_meshlet.m_cone_cutoff > 1.f)
+    return false;
+
+  if(!m_is_perspective)
+    {
+    double const length = std::sqrt(m_camera[0] * m_camera[0] + m_camera[1] * m_camera[1] + m_camera[2] * m_camera[2]);
+    double const dot = m_camera[0] * i_meshlet.m_cone_axis[0] + m_camera[1] * i_meshlet.m_cone_axis[1] + m_camera[2] * i_meshlet.m_cone_axis[2];
+    return length > 0.0 && dot >= i_meshlet.m_cone_cutoff * length;
+    }
+
+  // Every n in the cone has dot(n, p - eye) >= 0 for every p in the sphere
+  double view[3];
+  double dot = 0.0;
+  for(int k = 0; k < 3; ++k)
+    {
+    view[k] = i_meshlet.m_center[k] - m_camera[k];
+    dot += view[k] * i_meshlet.m_cone_axis[k] * m_front_sign;
+    }
+  double const distance = std::sqrt(view[0] * view[0] + view[1] * view[1] + view[2] * view[2]);
+  return dot >= i_meshlet.m_cone_cutoff * distance + i_meshlet.m_radius;
+  }
+
+//-----------------------------------------------------------------------------
+inline bool
+MeshletCuller::IsOutside(Meshlet const& i_meshlet) const
+  {
+  double min_x = 0.0, max_x = 0.0, min_y = 0.0, max_y = 0.0;
+  for(int corner = 0; corner < 8; ++corner)
+    {
+    double const point[4] = {(corner & 1) ? i_meshlet.m_max[0] : i_meshlet.m_min[0],
+                             (corner & 2) ? i_meshlet.m_max[1] : i_meshlet.m_min[1],
+                             (corner & 4) ? i_meshlet.m_max[2] : i_meshlet.m_min[2], 1.0};
+    double transformed[4];
+    for(int row = 0; row < 4; ++row)
+      transformed[row] = m_transform[row][0] * point[0] + m_transform[row][1] * point[1]
+                       + m_transform[row][2] * point[2] + m_transform[row][3];
+    if(transformed[3] <= 0.0)
+      return false; // crosses the camera plane, screen bounds are meaningless
+    double const x = transformed[0] / transformed[3];
+    double const y = transformed[1] / transformed[3];
+    min_x = corner == 0 ? x : std::min(min_x, x);
+    max_x = corner == 0 ? x : std::max(max_x, x);
+    min_y = corner == 0 ? y : std::min(min_y, y);
+    max_y = corner == 0 ? y : std::max(max_y, y);
+    }
+  // One pixel margin for the truncation to integer screen coordinates
+  return max_x < -1.0 || max_y < -1.0 || min_x > m_width || min_y > m_height;
+  }
+
+
+} // namespace Geometry
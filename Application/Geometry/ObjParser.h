@@ -0,0 +1,348 @@
+
+#pragma once
+
+#include "./../Global/ParallelFor.h"
+
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+
+namespace Geometry {
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ObjCounts // struct //
+///////////////////////////////////////////////////////////////////////////////
+struct ObjCounts
+  {
+  std::size_t m_vertices;
+  std::size_t m_textures;
+  std::size_t m_normals;
+  std::size_t m_faces;
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ObjLayout // struct //
+///////////////////////////////////////////////////////////////////////////////
+// Obj text split into chunks of whole lines, with the records every chunk starts at.
+// Doesn't depend on the mesh type, so one split can size meshes of any index type.
+struct ObjLayout
+  {
+  std::vector<char const*> m_bounds; // chunk i is [m_bounds[i], m_bounds[i + 1])
+  std::vector<ObjCounts> m_offsets;  // records of all chunks before chunk i
+  ObjCounts m_total;
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ObjParser // struct declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Wavefront obj tokenizer working directly on a memory buffer (e.g. MappedFile).
+// Understands the same subset as the original stream based Mesh reader:
+// "v", "vt", "vn" records with 3 coordinates and "f v/vt/vn v/vt/vn v/vt/vn".
+// Numbers are converted by std::from_chars, so floats are rounded the same way
+// as by operator>>. Count() is a cheap pass used to size arrays for Parse().
+template<typename TMesh>
+struct ObjParser
+  {
+  using VertexType = typename TMesh::VertexType;
+  using TextureType = typename TMesh::TextureType;
+  using NormalType = typename TMesh::NormalType;
+  using Index = typename TMesh::Index;
+  using Face = typename TMesh::Face;
+
+  using Counts = ObjCounts;
+  using Layout = ObjLayout;
+
+  static Counts Count(char const* ip_begin, char const* ip_end);
+
+  // Outputs must have room for exactly what Count() returned for the same text
+  static void Parse(char const* ip_begin, char const* ip_end,
+                    VertexType* op_vertices, TextureType* op_textures, NormalType* op_normals, Face* op_faces);
+
+  // Whole file: text is split at line boundaries and chunks are counted on all threads
+  static Layout Split(char const* ip_begin, char const* ip_end, std::size_t i_threads_count = 0);
+
+  // Chunks of i_layout (from Split() of the same text) are parsed on all threads straight
+  // into their place in the arrays, so the order is the same as of a sequential read
+  static void Load(Layout const& i_layout,
+                   std::vector<VertexType>& o_vertices, std::vector<TextureType>& o_textures,
+                   std::vector<NormalType>& o_normals, std::vector<Face>& o_faces,
+                   std::size_t i_threads_count = 0);
+  static void Load(char const* ip_begin, char const* ip_end,
+                   std::vector<VertexType>& o_vertices, std::vector<TextureType>& o_textures,
+                   std::vector<NormalType>& o_normals, std::vector<Face>& o_faces,
+                   std::size_t i_threads_count = 0);
+
+  private:
+    static constexpr std::size_t _MinChunkSize = 1 << 20; // smaller files are not worth threads
+    using IndexValueType = typename Index::value_type;
+
+    enum class _Record
+      {
+      Vertex,
+      Texture,
+      Normal,
+      Face,
+      Other
+      };
+
+    static _Record _GetRecord(char const* ip_line, char const* ip_end);
+    static char const* _GetLineEnd(char const* ip_line, char const* ip_end);
+    static char const* _GetNextLine(char const* ip_line_end, char const* ip_end);
+    static char const* _SkipSpaces(char const* ip_text, char const* ip_end);
+
+    template<typename T>
+    static void _ParseCoordinates(char const* ip_text, char const* ip_end, T& o_value);
+    static void _ParseFace(char const* ip_text, char const* ip_end, Face& o_face);
+    static bool _ParseFaceVertex(char const*& io_text, char const* ip_end, IndexValueType (&o_indices)[3]);
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ObjParser // struct definition //
+///////////////////////////////////////////////////////////////////////////////
+template<typename TMesh>
+typename ObjParser<TMesh>::Counts
+ObjParser<TMesh>::Count(char const* ip_begin, char const* ip_end)
+  {
+  Counts counts = {0, 0, 0, 0};
+  for(char const* p_line = ip_begin; p_line < ip_end; p_line = _GetNextLine(_GetLineEnd(p_line, ip_end), ip_end))
+    {
+    switch(_GetRecord(p_line, ip_end))
+      {
+      case _Record::Vertex:  ++counts.m_vertices; break;
+      case _Record::Texture: ++counts.m_textures; break;
+      case _Record::Normal:  ++counts.m_normals;  break;
+      case _Record::Face:    ++counts.m_faces;    break;
+      case _Record::Other:                        break;
+      }
+    }
+  return counts;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TMesh>
+void
+ObjParser<TMesh>::Parse(char const* ip_begin, char const* ip_end,
+                        VertexType* op_vertices, TextureType* op_textures, NormalType* op_normals, Face* op_faces)
+  {
+  for(char const* p_line = ip_begin; p_line < ip_end; )
+    {
+    char const* p_line_end = _GetLineEnd(p_line, ip_end);
+    switch(_GetRecord(p_line, ip_end))
+      {
+      case _Record::Vertex:  _ParseCoordinates(p_line + 2, p_line_end, *op_vertices++); break;
+      case _Record::Texture: _ParseCoordinates(p_line + 3, p_line_end, *op_textures++); break;
+      case _Record::Normal:  _ParseCoordinates(p_line + 3, p_line_end, *op_normals++);  break;
+      case _Record::Face:    _ParseFace(p_line + 2, p_line_end, *op_faces++);           break;
+      case _Record::Other:                                                               break;
+      }
+    p_line = _GetNextLine(p_line_end, ip_end);
+    }
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TMesh>
+typename ObjParser<TMesh>::Layout
+ObjParser<TMesh>::Split(char const* ip_begin, char const* ip_end, std::size_t i_threads_count)
+  {
+  std::size_t const size = static_cast<std::size_t>(ip_end - ip_begin);
+  std::size_t const threads_count = Global::GetThreadsCount(i_threads_count);
+  // A few chunks per thread, so a slow chunk doesn't hold everyone
+  std::size_t const chunks_count = std::max<std::size_t>(1, std::min(size / _MinChunkSize, 4 * threads_count));
+
+  Layout layout;
+  std::vector<char const*>& bounds = layout.m_bounds;
+  bounds.resize(chunks_count + 1);
+  bounds.front() = ip_begin;
+  bounds.back() = ip_end;
+  for(std::size_t i = 1; i < chunks_count; ++i)
+    {
+    char const* p_split = std::max(ip_begin + size / chunks_count * i, bounds[i - 1]);
+    char const* p_line_end = _GetLineEnd(p_split, ip_end);
+    bounds[i] = _GetNextLine(p_line_end, ip_end);
+    }
+
+  std::vector<Counts> counts(chunks_count);
+  Global::ParallelFor(chunks_count, [&](std::size_t i_chunk)
+    {
+    counts[i_chunk] = Count(bounds[i_chunk], bounds[i_chunk + 1]);
+    }, i_threads_count);
+
+  // Prefix sums: every chunk knows where its records start
+  layout.m_offsets.resize(chunks_count);
+  Counts& total = layout.m_total;
+  total = {0, 0, 0, 0};
+  for(std::size_t i = 0; i < chunks_count; ++i)
+    {
+    layout.m_offsets[i] = total;
+    total.m_vertices += counts[i].m_vertices;
+    total.m_textures += counts[i].m_textures;
+    total.m_normals += counts[i].m_normals;
+    total.m_faces += counts[i].m_faces;
+    }
+  return layout;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TMesh>
+void
+ObjParser<TMesh>::Load(Layout const& i_layout,
+                       std::vector<VertexType>& o_vertices, std::vector<TextureType>& o_textures,
+                       std::vector<NormalType>& o_normals, std::vector<Face>& o_faces,
+                       std::size_t i_threads_count)
+  {
+  o_vertices.resize(i_layout.m_total.m_vertices);
+  o_textures.resize(i_layout.m_total.m_textures);
+  o_normals.resize(i_layout.m_total.m_normals);
+  o_faces.resize(i_layout.m_total.m_faces);
+
+  Global::ParallelFor(i_layout.m_offsets.size(), [&](std::size_t i_chunk)
+    {
+    Counts const& offset = i_layout.m_offsets[i_chunk];
+    Parse(i_layout.m_bounds[i_chunk], i_layout.m_bounds[i_chunk + 1], o_vertices.data() + offset.m_vertices,
+          o_textures.data() + offset.m_textures, o_normals.data() + offset.m_normals, o_faces.data() + offset.m_faces);
+    }, i_threads_count);
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TMesh>
+void
+ObjParser<TMesh>::Load(char const* ip_begin, char const* ip_end,
+                       std::vector<VertexType>& o_vertices, std::vector<TextureType>& o_textures,
+                       std::vector<NormalType>& o_normals, std::vector<Face>& o_faces,
+                       std::size_t i_threads_count)
+  {
+  Load(Split(ip_begin, ip_end, i_threads_count), o_vertices, o_textures, o_normals, o_faces, i_threads_count);
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TMesh>
+typename ObjParser<TMesh>::_Record
+ObjParser<TMesh>::_GetRecord(char const* ip_line, char const* ip_end)
+  {
+  std::size_t const length = static_cast<std::size_t>(ip_end - ip_line);
+  if(length >= 2 && ip_line[1] == ' ')
+    {
+    if(ip_line[0] == 'v')
+      return _Record::Vertex;
+    if(ip_line[0] == 'f')
+      return _Record::Face;
+    }
+  else if(length >= 3 && ip_line[0] == 'v' && ip_line[2] == ' ')
+    {
+    if(ip_line[1] == 't')
+      return _Record::Texture;
+    if(ip_line[1] == 'n')
+      return _Record::Normal;
+    }
+  return _Record::Other;
+  }
+
+//-----------------------------------------------------------------------------
+// Position of '\n' ending the line or ip_end for the last line
+template<typename TMesh>
+char const*
+ObjParser<TMesh>::_GetLineEnd(char const* ip_line, char const* ip_end)
+  {
+  auto p_end = static_cast<char const*>(std::memchr(ip_line, '\n', static_cast<std::size_t>(ip_end - ip_line)));
+  return p_end != nullptr ? p_end : ip_end;
+  }
+
+//-----------------------------------------------------------------------------
+// Start of the line after ip_line_end, never past ip_end
+template<typename TMesh>
+char const*
+ObjParser<TMesh>::_GetNextLine(char const* ip_line_end, char const* ip_end)
+  {
+  return ip_line_end < ip_end ? ip_line_end + 1 : ip_end;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TMesh>
+char const*
+ObjParser<TMesh>::_SkipSpaces(char const* ip_text, char const* ip_end)
+  {
+  while(ip_text < ip_end && (*ip_text == ' ' || *ip_text == '\t' || *ip_text == '\r' || *ip_text == '\v' || *ip_text == '\f'))
+    ++ip_text;
+  return ip_text;
+  }
+
+//-----------------------------------------------------------------------------
+// Reads 3 coordinates; like stream extraction, a failed one is zero and stops reading
+template<typename TMesh>
+template<typename T>
+void
+ObjParser<TMesh>::_ParseCoordinates(char const* ip_text, char const* ip_end, T& o_value)
+  {
+  using ValueType = typename std::decay<decltype(o_value[0])>::type;
+  bool is_failed = false;
+  for(std::size_t i = 0; i < 3; ++i)
+    {
+    if(is_failed)
+      {
+      o_value[i] = ValueType();
+      continue;
+      }
+    ip_text = _SkipSpaces(ip_text, ip_end);
+    if(ip_text < ip_end && *ip_text == '+') // from_chars doesn't accept explicit plus
+      ++ip_text;
+    ValueType value = ValueType();
+    auto const result = std::from_chars(ip_text, ip_end, value);
+    is_failed = result.ec != std::errc();
+    o_value[i] = is_failed ? ValueType() : value;
+    ip_text = result.ptr;
+    }
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TMesh>
+void
+ObjParser<TMesh>::_ParseFace(char const* ip_text, char const* ip_end, Face& o_face)
+  {
+  std::size_t i = 0;
+  for(IndexValueType indices[3]; _ParseFaceVertex(ip_text, ip_end, indices); ++i)
+    {
+    assert(i < 3);
+    if(i >= 3)
+      continue;
+    // in wavefront obj all indices start at 1, not zero
+    std::get<0>(o_face)[i] = static_cast<IndexValueType>(indices[0] - 1);
+    std::get<1>(o_face)[i] = static_cast<IndexValueType>(indices[1] - 1);
+    std::get<2>(o_face)[i] = static_cast<IndexValueType>(indices[2] - 1);
+    }
+  assert(i == 3);
+  }
+
+//-----------------------------------------------------------------------------
+// Reads "v/vt/vn"; any single character is accepted as a separator, as "iss >> trash" did
+template<typename TMesh>
+bool
+ObjParser<TMesh>::_ParseFaceVertex(char const*& io_text, char const* ip_end, IndexValueType (&o_indices)[3])
+  {
+  for(std::size_t j = 0; j < 3; ++j)
+    {
+    io_text = _SkipSpaces(io_text, ip_end);
+    if(j != 0)
+      {
+      if(io_text == ip_end)
+        return false;
+      io_text = _SkipSpaces(io_text + 1, ip_end);
+      }
+    auto const result = std::from_chars(io_text, ip_end, o_indices[j]);
+    if(result.ec != std::errc())
+      return false;
+    io_text = result.ptr;
+    }
+  return true;
+  }
+
+} // namespace Geometry
@@ -29,11 +29,11 @@ struct Point : Array<TValueType, NDimension>
   using VectorType = Vector<ValueType, Dimension>;
 
   // Lifetime
-  Point();
-  template<typename ... TArgs>
-  Point(TArgs&& ... i_args); // N args constructor
-  template<typename TSelf>
-  Point(TSelf&& i_rhs); // Copy - Move constructor
+  // Copy and move are implicit, so the type stays trivially copyable
+  constexpr Point(); // zero point
+  template<typename ... TArgs, typename = std::enable_if_t<sizeof...(TArgs) == NDimension>>
+  constexpr Point(TArgs const& ... i_args); // N args constructor
+  constexpr Point(Ancestor const& i_rhs); // Conversion from any Array of the same type
 
   using Ancestor::Get;
   using Ancestor::Set;
@@ -58,24 +58,26 @@ struct Point : Array<TValueType, NDimension>
 // Point // struct definition //
 ///////////////////////////////////////////////////////////////////////////////
 template<typename TValueType, DimensionType NPointDimension>
+constexpr
 Point<TValueType, NPointDimension>::Point()
+  : Ancestor(Data{})
   {
-  GetData().fill(ValueType());
   }
 
 //-----------------------------------------------------------------------------
 template<typename TValueType, DimensionType NPointDimension>
-template<typename ... TArgs>
-Point<TValueType, NPointDimension>::Point(TArgs&& ... i_args)
-  : Ancestor(std::forward<TArgs>(i_args)...)
+template<typename ... TArgs, typename>
+constexpr
+Point<TValueType, NPointDimension>::Point(TArgs const& ... i_args)
+  : Ancestor(i_args...)
   {
   }
 
 //-----------------------------------------------------------------------------
 template<typename TValueType, DimensionType NPointDimension>
-template<typename TSelf>
-Point<TValueType, NPointDimension>::Point(TSelf&& i_rhs)
-  : Ancestor(std::forward<Ancestor>(i_rhs))
+constexpr
+Point<TValueType, NPointDimension>::Point(Ancestor const& i_rhs)
+  : Ancestor(i_rhs)
   {
   }
 
@@ -174,4 +176,8 @@ Point<TValueType, NPointDimension>::operator+=(VectorType const& i_vec)
   }
 
 
+static_assert(std::is_trivially_copyable<Point<float, 3>>::value, "Point is expected to be trivially copyable");
+static_assert(sizeof(Point<float, 3>) == 3 * sizeof(float), "Point is expected to be packed as ValueType[N]");
+
+
 } // namespace Geometry
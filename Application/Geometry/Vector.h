@@ -30,11 +30,11 @@ struct Vector : Array<TValueType, NDimension>
   using Data = typename Ancestor::Data;
 
   // Lifetime
-  Vector();
-  template<typename ... TArgs>
-  Vector(TArgs&& ... i_args); // N args constructor
-  template<typename TSelf>
-  Vector(TSelf&& i_rhs); // Copy - Move constructor
+  // Copy and move are implicit, so the type stays trivially copyable
+  Vector() = default; // elements are left uninitialized
+  template<typename ... TArgs, typename = std::enable_if_t<sizeof...(TArgs) == NDimension>>
+  constexpr Vector(TArgs const& ... i_args); // N args constructor
+  constexpr Vector(Ancestor const& i_rhs); // Conversion from any Array of the same type
 
   using Ancestor::Get;
   using Ancestor::Set;
@@ -75,23 +75,18 @@ struct Vector : Array<TValueType, NDimension>
 // Vector // struct definition //
 ///////////////////////////////////////////////////////////////////////////////
 template<typename TValueType, DimensionType NDimension>
-Vector<TValueType, NDimension>::Vector()
+template<typename ... TArgs, typename>
+constexpr
+Vector<TValueType, NDimension>::Vector(TArgs const& ... i_args)
+  : Ancestor(i_args...)
   {
   }
 
 //-----------------------------------------------------------------------------
 template<typename TValueType, DimensionType NDimension>
-template<typename ... TArgs>
-Vector<TValueType, NDimension>::Vector(TArgs&& ... i_args)
-  : Ancestor(std::forward<TArgs>(i_args)...)
-  {
-  }
-
-//-----------------------------------------------------------------------------
-template<typename TValueType, DimensionType NDimension>
-template<typename TSelf>
-Vector<TValueType, NDimension>::Vector(TSelf&& i_rhs)
-  : Ancestor(std::forward<Ancestor>(i_rhs))
+constexpr
+Vector<TValueType, NDimension>::Vector(Ancestor const& i_rhs)
+  : Ancestor(i_rhs)
   {
   }
 
@@ -273,4 +268,8 @@ Vector<TValueType, NDimension>::operator+=(Self const& i_vec)
   }
 
 
+static_assert(std::is_trivially_copyable<Vector<float, 3>>::value, "Vector is expected to be trivially copyable");
+static_assert(sizeof(Vector<float, 3>) == 3 * sizeof(float), "Vector is expected to be packed as ValueType[N]");
+
+
 } // namespace Geometry
@@ -0,0 +1,111 @@
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+
+
+namespace Global {
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ArrayView // class declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Non-owning contiguous range with the part of std::vector interface used for
+// reading, so containers backed by foreign memory (e.g. MappedFile) can be
+// passed where mesh code expects vector-like accessors.
+template<typename T>
+class ArrayView
+  {
+  public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using const_iterator = T const*;
+
+    ArrayView();
+    ArrayView(T const* ip_data, std::size_t i_size);
+
+    T const* data() const;
+    std::size_t size() const;
+    bool empty() const;
+
+    T const* begin() const;
+    T const* end() const;
+
+    T const& operator[](std::size_t i_idx) const;
+
+  private:
+    T const* mp_data;
+    std::size_t m_size;
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ArrayView // class definition //
+///////////////////////////////////////////////////////////////////////////////
+template<typename T>
+ArrayView<T>::ArrayView()
+  : mp_data(nullptr)
+  , m_size(0)
+  {
+  }
+
+//-----------------------------------------------------------------------------
+template<typename T>
+ArrayView<T>::ArrayView(T const* ip_data, std::size_t i_size)
+  : mp_data(ip_data)
+  , m_size(i_size)
+  {
+  }
+
+//-----------------------------------------------------------------------------
+template<typename T>
+T const*
+ArrayView<T>::data() const
+  {
+  return mp_data;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename T>
+std::size_t
+ArrayView<T>::size() const
+  {
+  return m_size;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename T>
+bool
+ArrayView<T>::empty() const
+  {
+  return m_size == 0;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename T>
+T const*
+ArrayView<T>::begin() const
+  {
+  return mp_data;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename T>
+T const*
+ArrayView<T>::end() const
+  {
+  return mp_data + m_size;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename T>
+T const&
+ArrayView<T>::operator[](std::size_t i_idx) const
+  {
+  assert(i_idx < m_size);
+  return mp_data[i_idx];
+  }
+
+
+} // namespace Global
@@ -0,0 +1,251 @@
+
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace Global {
+
+
+///////////////////////////////////////////////////////////////////////////////
+// MappedFile // class declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Read-only memory mapping of a whole file. Pages are loaded by the OS on first
+// access, so nothing is copied into user buffers. Empty or missing files are
+// reported by IsOpen() == false, the same way std::ifstream::fail() does.
+class MappedFile
+  {
+  public:
+    MappedFile(); // not open
+    explicit MappedFile(const char* i_filename);
+    MappedFile(MappedFile&& i_rhs);
+    MappedFile& operator=(MappedFile&& i_rhs);
+    ~MappedFile();
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    bool IsOpen() const;
+    char const* GetBegin() const;
+    char const* GetEnd() const;
+    std::size_t GetSize() const;
+
+  private:
+    void _Close();
+
+    char const* mp_data;
+    std::size_t m_size;
+#if defined(_WIN32)
+    HANDLE m_file;
+    HANDLE m_mapping;
+#endif
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// MappedFile // class definition //
+///////////////////////////////////////////////////////////////////////////////
+#if defined(_WIN32)
+
+inline
+MappedFile::MappedFile(const char* i_filename)
+  : mp_data(nullptr)
+  , m_size(0)
+  , m_file(INVALID_HANDLE_VALUE)
+  , m_mapping(nullptr)
+  {
+  m_file = ::CreateFileA(i_filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                         FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if(m_file == INVALID_HANDLE_VALUE)
+    return;
+
+  LARGE_INTEGER size;
+  if(!::GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+    {
+    _Close();
+    return;
+    }
+
+  m_mapping = ::CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if(m_mapping == nullptr)
+    {
+    _Close();
+    return;
+    }
+
+  mp_data = static_cast<char const*>(::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+  if(mp_data == nullptr)
+    {
+    _Close();
+    return;
+    }
+  m_size = static_cast<std::size_t>(size.QuadPart);
+  }
+
+//-----------------------------------------------------------------------------
+inline void
+MappedFile::_Close()
+  {
+  if(mp_data != nullptr)
+    ::UnmapViewOfFile(mp_data);
+  if(m_mapping != nullptr)
+    ::CloseHandle(m_mapping);
+  if(m_file != INVALID_HANDLE_VALUE)
+    ::CloseHandle(m_file);
+  mp_data = nullptr;
+  m_size = 0;
+  m_mapping = nullptr;
+  m_file = INVALID_HANDLE_VALUE;
+  }
+
+//-----------------------------------------------------------------------------
+inline
+MappedFile::MappedFile(MappedFile&& i_rhs)
+  : mp_data(i_rhs.mp_data)
+  , m_size(i_rhs.m_size)
+  , m_file(i_rhs.m_file)
+  , m_mapping(i_rhs.m_mapping)
+  {
+  i_rhs.mp_data = nullptr;
+  i_rhs.m_size = 0;
+  i_rhs.m_file = INVALID_HANDLE_VALUE;
+  i_rhs.m_mapping = nullptr;
+  }
+
+//-----------------------------------------------------------------------------
+inline MappedFile&
+MappedFile::operator=(MappedFile&& i_rhs)
+  {
+  if(this != &i_rhs)
+    {
+    _Close();
+    std::swap(mp_data, i_rhs.mp_data);
+    std::swap(m_size, i_rhs.m_size);
+    std::swap(m_file, i_rhs.m_file);
+    std::swap(m_mapping, i_rhs.m_mapping);
+    }
+  return *this;
+  }
+
+#else
+
+inline
+MappedFile::MappedFile(const char* i_filename)
+  : mp_data(nullptr)
+  , m_size(0)
+  {
+  int const file = ::open(i_filename, O_RDONLY);
+  if(file < 0)
+    return;
+
+  struct stat file_stat;
+  if(::fstat(file, &file_stat) == 0 && file_stat.st_size > 0)
+    {
+    void* p_data = ::mmap(nullptr, static_cast<std::size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    if(p_data != MAP_FAILED)
+      {
+      ::madvise(p_data, static_cast<std::size_t>(file_stat.st_size), MADV_SEQUENTIAL);
+      mp_data = static_cast<char const*>(p_data);
+      m_size = static_cast<std::size_t>(file_stat.st_size);
+      }
+    }
+  ::close(file); // Mapping stays valid without the descriptor
+  }
+
+//-----------------------------------------------------------------------------
+inline void
+MappedFile::_Close()
+  {
+  if(mp_data != nullptr)
+    ::munmap(const_cast<char*>(mp_data), m_size);
+  mp_data = nullptr;
+  m_size = 0;
+  }
+
+//-----------------------------------------------------------------------------
+inline
+MappedFile::MappedFile(MappedFile&& i_rhs)
+  : mp_data(i_rhs.mp_data)
+  , m_size(i_rhs.m_size)
+  {
+  i_rhs.mp_data = nullptr;
+  i_rhs.m_size = 0;
+  }
+
+//-----------------------------------------------------------------------------
+inline MappedFile&
+MappedFile::operator=(MappedFile&& i_rhs)
+  {
+  if(this != &i_rhs)
+    {
+    _Close();
+    std::swap(mp_data, i_rhs.mp_data);
+    std::swap(m_size, i_rhs.m_size);
+    }
+  return *this;
+  }
+
+#endif
+
+//-----------------------------------------------------------------------------
+inline
+MappedFile::MappedFile()
+  : mp_data(nullptr)
+  , m_size(0)
+#if defined(_WIN32)
+  , m_file(INVALID_HANDLE_VALUE)
+  , m_mapping(nullptr)
+#endif
+  {
+  }
+
+//-----------------------------------------------------------------------------
+inline
+MappedFile::~MappedFile()
+  {
+  _Close();
+  }
+
+//-----------------------------------------------------------------------------
+inline bool
+MappedFile::IsOpen() const
+  {
+  return mp_data != nullptr;
+  }
+
+//-----------------------------------------------------------------------------
+inline char const*
+MappedFile::GetBegin() const
+  {
+  return mp_data;
+  }
+
+//-----------------------------------------------------------------------------
+inline char const*
+MappedFile::GetEnd() const
+  {
+  return mp_data + m_size;
+  }
+
+//-----------------------------------------------------------------------------
+inline std::size_t
+MappedFile::GetSize() const
+  {
+  return m_size;
+  }
+
+
+} // namespace Global
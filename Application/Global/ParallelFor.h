@@ -0,0 +1,79 @@
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace Global {
+
+
+///////////////////////////////////////////////////////////////////////////////
+// GetThreadsCount // function definition //
+///////////////////////////////////////////////////////////////////////////////
+// 0 means "as many as hardware supports"
+inline std::size_t GetThreadsCount(std::size_t i_requested = 0)
+  {
+  if(i_requested != 0)
+    return i_requested;
+  std::size_t const hardware = std::thread::hardware_concurrency();
+  return hardware != 0 ? hardware : 1;
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ParallelFor // function definition //
+///////////////////////////////////////////////////////////////////////////////
+// Calls i_body(i) for every i in [0, i_count). Items are handed out one by one
+// through an atomic counter, so unbalanced items are spread over all workers.
+// Calling thread works too. First thrown exception is rethrown after join.
+template<typename F>
+void ParallelFor(std::size_t i_count, F const& i_body, std::size_t i_threads_count = 0)
+  {
+  std::size_t const threads_count = std::min(GetThreadsCount(i_threads_count), i_count);
+  if(threads_count <= 1)
+    {
+    for(std::size_t i = 0; i < i_count; ++i)
+      i_body(i);
+    return;
+    }
+
+  std::atomic<std::size_t> next_item(0);
+  std::exception_ptr p_exception;
+  std::mutex exception_mutex;
+
+  auto worker = [&]()
+    {
+    try
+      {
+      for(std::size_t i = next_item++; i < i_count; i = next_item++)
+        i_body(i);
+      }
+    catch(...)
+      {
+      std::lock_guard<std::mutex> lock(exception_mutex);
+      if(!p_exception)
+        p_exception = std::current_exception();
+      next_item = i_count; // stop the others as soon as possible
+      }
+    };
+
+  std::vector<std::thread> threads;
+  threads.reserve(threads_count - 1);
+  for(std::size_t i = 1; i < threads_count; ++i)
+    threads.emplace_back(worker);
+  worker();
+  for(auto& thread : threads)
+    thread.join();
+
+  if(p_exception)
+    std::rethrow_exception(p_exception);
+  }
+
+
+} // namespace Global
@@ -1,9 +1,19 @@
 ﻿
 #include "./Canvas.h"
+#include "./HalfSpaceTriangle.h"
 
+#include "./../Geometry/BatchTransform.h"
 #include "./../Geometry/LinearInterpolationIterator.h"
+#include "./../Global/ParallelFor.h"
 
 #include <algorithm>
+#include <cmath>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CANVAS_SSE2
+#include <emmintrin.h>
+#endif
 
 template<typename TPointType, DimensionType NDirection>
 using LIIterator = Geometry::LinearInterpolationIterator<TPointType, NDirection>;
@@ -11,39 +21,181 @@ using LIIterator = Geometry::LinearInterpolationIterator<TPointType, NDirection>
 template<typename TPointType>
 using DrawHLineIterator = LIIterator<typename std::RemoveTypeByIndex<TPointType, 1>::Type, 0>;
 
+// Iterators are created per scanline, they must not own any heap memory
+static_assert(std::is_trivially_destructible<DrawHLineIterator<Graphics::Canvas::Point>>::value,
+              "LinearInterpolationIterator is expected to keep its state inline");
+
+namespace {
+
+
+///////////////////////////////////////////////////////////////////////////////
+// HalfSpaceFragment // struct //
+///////////////////////////////////////////////////////////////////////////////
+// Pixel produced by the half-space rasterizer. Gives color getters the same
+// Get<N> as DrawHLineIterator: 0 - x, 1 - z, 2.. - attributes (y is skipped).
+template<typename TPoint>
+struct HalfSpaceFragment
+  {
+  template<DimensionType N>
+  using PointIndex = std::integral_constant<DimensionType, (N == 0 ? 0 : N + 1)>;
+
+  template<DimensionType N>
+  typename std::tuple_element<PointIndex<N>::value, TPoint>::type Get() const
+    {
+    return std::get<PointIndex<N>::value>(m_point);
+    }
+
+  TPoint m_point;
+  };
+
+//-----------------------------------------------------------------------------
+template<typename T>
+T RoundTo(float i_value, std::true_type /*is_integral*/)
+  {
+  return static_cast<T>(std::floor(i_value + 0.5f));
+  }
+
+//-----------------------------------------------------------------------------
+template<typename T>
+T RoundTo(float i_value, std::false_type /*is_integral*/)
+  {
+  return static_cast<T>(i_value);
+  }
+
+//-----------------------------------------------------------------------------
+// Interpolates z and all attributes (items 2..N) by barycentric weights of 2nd and 3rd points
+template<typename TPoint, std::size_t... Is>
+void InterpolateAttributes(TPoint& o_point, TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3,
+                           float i_w2, float i_w3, std::index_sequence<Is...>)
+  {
+  using Expander = int[];
+  (void) Expander{0, (std::get<Is + 2>(o_point) =
+    RoundTo<typename std::tuple_element<Is + 2, TPoint>::type>(
+      static_cast<float>(std::get<Is + 2>(i_pt1))
+      + i_w2 * static_cast<float>(std::get<Is + 2>(i_pt2) - std::get<Is + 2>(i_pt1))
+      + i_w3 * static_cast<float>(std::get<Is + 2>(i_pt3) - std::get<Is + 2>(i_pt1)),
+      std::is_integral<typename std::tuple_element<Is + 2, TPoint>::type>()), 0)...};
+  }
+
+//-----------------------------------------------------------------------------
+// z of the 8 pixels of a block row starting at i_x, rounded the same way as by InterpolateAttributes
+template<typename TZ, typename TPoint, typename TEdge>
+void InterpolateBlockRowDepth(TZ (&o_z)[8], int i_x, int i_y, TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3,
+                              TEdge const& i_edge2, TEdge const& i_edge3, float i_inversed_area)
+  {
+  using ZType = typename std::tuple_element<2, TPoint>::type;
+  for(int i = 0; i < 8; ++i)
+    {
+    float const w2 = i_edge2.Evaluate(i_x + i, i_y) * i_inversed_area;
+    float const w3 = i_edge3.Evaluate(i_x + i, i_y) * i_inversed_area;
+    o_z[i] = static_cast<TZ>(RoundTo<ZType>(
+      static_cast<float>(std::get<2>(i_pt1))
+      + w2 * static_cast<float>(std::get<2>(i_pt2) - std::get<2>(i_pt1))
+      + w3 * static_cast<float>(std::get<2>(i_pt3) - std::get<2>(i_pt1)),
+      std::is_integral<ZType>()));
+    }
+  }
+
+
+} // namespace
+
 namespace Graphics {
 
 
 //-----------------------------------------------------------------------------
-Canvas::Canvas(DimensionType i_w, DimensionType i_h)
-  : m_image(i_w, i_h, false)
+Canvas::Canvas(DimensionType i_w, DimensionType i_h, PixelFormat i_pixel_format, DepthFormat i_depth_format)
+  : m_width(i_w)
+  , m_height(i_h)
+  , m_pixel_format(i_pixel_format)
+  , m_depth_format(i_depth_format)
+  , m_target(_CreateTarget(i_w, i_h, i_pixel_format, i_depth_format))
+  , m_converted_image()
+  , m_is_converted_image_outdated(true)
   , m_texture_image()
-  , m_z_buffer(i_w, i_h, false)
+  , m_rasterizer(Rasterizer::Scanline)
+  , m_binning_enabled(false)
+  , m_tile_size(64)
+  , m_threads_count(0)
+  , m_deferred_shading_enabled(false)
+  , m_hierarchical_z_enabled(false)
+  , m_triangles_culled(0)
+  , m_tiles_culled(0)
+  , m_meshlets_culled(0)
+  , m_faces_culled(0)
   {
-  Color black;
-  black.Fill(0);
-  m_image.Fill(black);
-  m_z_buffer.Fill(std::numeric_limits<Buffer::PixelType>::min());
+  }
+
+//-----------------------------------------------------------------------------
+Canvas::PixelFormat
+Canvas::GetPixelFormat() const
+  {
+  return m_pixel_format;
+  }
+
+//-----------------------------------------------------------------------------
+Canvas::DepthFormat
+Canvas::GetDepthFormat() const
+  {
+  return m_depth_format;
   }
 
 //-----------------------------------------------------------------------------
 Canvas::Image&
 Canvas::GetImage()
   {
-  return m_image;
+  Flush();
+  Image* p_image = &m_converted_image;
+  std::visit([&](auto& io_target)
+    {
+    using ColorRow = typename std::decay_t<decltype(io_target)>::ColorRow;
+    if constexpr(std::is_same<ColorRow, _RGB8Row>::value)
+      p_image = &io_target.m_color;
+    else if(m_is_converted_image_outdated)
+      {
+      // A new image: the previous one may be shared by copies or viewed flipped by the caller
+      Image image(m_width, m_height, false);
+      for(DimensionType y = 0; y < m_height; ++y)
+        ColorRow::Read(io_target.m_color, static_cast<int>(y), image.GetRow(y));
+      m_converted_image = std::move(image);
+      m_is_converted_image_outdated = false;
+      }
+    }, m_target);
+  return *p_image;
   }
 
 //-----------------------------------------------------------------------------
-Canvas::Image const&
-Canvas::GetImage() const
+Canvas::PackedImage*
+Canvas::GetPackedImage()
   {
-  return m_image;
+  Flush();
+  PackedImage* p_image = nullptr;
+  _VisitTarget([&](auto& io_target)
+    {
+    if constexpr(std::is_same<typename std::decay_t<decltype(io_target)>::ColorRow, _RGBA8Row>::value)
+      p_image = &io_target.m_color;
+    });
+  return p_image;
+  }
+
+//-----------------------------------------------------------------------------
+Canvas::PlanarImage*
+Canvas::GetPlanarImage()
+  {
+  Flush();
+  PlanarImage* p_image = nullptr;
+  _VisitTarget([&](auto& io_target)
+    {
+    if constexpr(std::is_same<typename std::decay_t<decltype(io_target)>::ColorRow, _PlanarRGB8Row>::value)
+      p_image = &io_target.m_color;
+    });
+  return p_image;
   }
 
 //-----------------------------------------------------------------------------
 void
 Canvas::SetTextureImage(Image&& i_img)
   {
+  Flush(); // recorded triangles still refer to the current texture
   m_texture_image = std::move(i_img);
   }
 
@@ -51,31 +203,390 @@ Canvas::SetTextureImage(Image&& i_img)
 void
 Canvas::SetLightDirection(Normal const& i_light_direction)
   {
+  Flush(); // recorded triangles still refer to the current light
   m_light_direction = i_light_direction;
   }
 
 //-----------------------------------------------------------------------------
-bool
-Canvas::_Set(int i_x, int i_y, int i_z, Color const& i_color)
+void
+Canvas::SetBinning(bool i_enabled, DimensionType i_tile_size, DimensionType i_threads_count)
   {
-  if(static_cast<unsigned int>(i_x) >= m_image.GetWidth()
-     || static_cast<unsigned int>(i_y) >= m_image.GetHeight())
-    return false;
+  assert(i_tile_size > 0);
+  Flush();
+  DimensionType const hierarchical_z_tile = _HierarchicalZ::TileSize;
+  m_binning_enabled = i_enabled;
+  m_tile_size = (i_tile_size + hierarchical_z_tile - 1) / hierarchical_z_tile * hierarchical_z_tile;
+  m_threads_count = i_threads_count;
+  }
 
-  auto z_item = m_z_buffer.Get(i_x, i_y);
-  if(i_z < z_item)
-    return false;
+//-----------------------------------------------------------------------------
+void
+Canvas::SetDeferredShading(bool i_enabled)
+  {
+  Flush();
+  m_deferred_shading_enabled = i_enabled;
+  }
 
-  m_image.Set(i_x, i_y, i_color);
-  m_z_buffer.Set(i_x, i_y, i_z);
-  return true;
+//-----------------------------------------------------------------------------
+void
+Canvas::Flush()
+  {
+  if(m_recorded_triangles.empty())
+    return;
+
+  // Without binning the whole canvas is a single tile
+  _ClipRect const canvas_rect = _GetCanvasRect();
+  int const tile_size = m_binning_enabled ? static_cast<int>(m_tile_size) : std::max(canvas_rect.m_x1, canvas_rect.m_y1);
+  int const tiles_x = (canvas_rect.m_x1 + tile_size - 1) / tile_size;
+  int const tiles_y = (canvas_rect.m_y1 + tile_size - 1) / tile_size;
+
+  // Bins keep submission order, so z-test ties are resolved the same way as without binning
+  std::vector<std::vector<std::size_t>> bins(tiles_x * tiles_y);
+  for(std::size_t i = 0; i < m_recorded_triangles.size(); ++i)
+    {
+    _ClipRect const& bounds = m_recorded_triangles[i].m_bounds;
+    for(int tile_y = bounds.m_y0 / tile_size; tile_y <= (bounds.m_y1 - 1) / tile_size; ++tile_y)
+      for(int tile_x = bounds.m_x0 / tile_size; tile_x <= (bounds.m_x1 - 1) / tile_size; ++tile_x)
+        bins[tile_y * tiles_x + tile_x].push_back(i);
+    }
+
+  // Tiles write rows concurrently, copies of the buffers must be made before
+  _MakeTargetUnique();
+  Global::ParallelFor(bins.size(), [&](std::size_t i_tile)
+    {
+    int const tile_x = static_cast<int>(i_tile) % tiles_x;
+    int const tile_y = static_cast<int>(i_tile) / tiles_x;
+    _ClipRect tile_rect;
+    tile_rect.m_x0 = tile_x * tile_size;
+    tile_rect.m_y0 = tile_y * tile_size;
+    tile_rect.m_x1 = std::min(tile_rect.m_x0 + tile_size, canvas_rect.m_x1);
+    tile_rect.m_y1 = std::min(tile_rect.m_y0 + tile_size, canvas_rect.m_y1);
+    if(m_deferred_shading_enabled)
+      {
+      for(auto triangle_idx : bins[i_tile])
+        m_recorded_triangles[triangle_idx].m_draw(tile_rect, _Pass::DepthOnly);
+      for(auto triangle_idx : bins[i_tile])
+        m_recorded_triangles[triangle_idx].m_draw(tile_rect, _Pass::Shade);
+      }
+    else
+      {
+      for(auto triangle_idx : bins[i_tile])
+        m_recorded_triangles[triangle_idx].m_draw(tile_rect, _Pass::Color);
+      }
+    }, m_threads_count);
+
+  m_recorded_triangles.clear();
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::SetRasterizer(Rasterizer i_rasterizer)
+  {
+  Flush();
+  m_rasterizer = i_rasterizer;
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::SetHierarchicalZ(bool i_enabled)
+  {
+  Flush();
+  if(i_enabled && !m_hierarchical_z_enabled) // Depth buffer was not tracked while disabled
+    _VisitTarget([](auto& io_target)
+      {
+      io_target.m_hierarchical_z.Build(io_target.m_depth);
+      });
+  m_hierarchical_z_enabled = i_enabled;
+  }
+
+//-----------------------------------------------------------------------------
+Canvas::CullingStatistics
+Canvas::GetCullingStatistics() const
+  {
+  CullingStatistics statistics;
+  statistics.m_triangles_culled = m_triangles_culled;
+  statistics.m_tiles_culled = m_tiles_culled;
+  statistics.m_meshlets_culled = m_meshlets_culled;
+  statistics.m_faces_culled = m_faces_culled;
+  return statistics;
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::ResetCullingStatistics()
+  {
+  m_triangles_culled = 0;
+  m_tiles_culled = 0;
+  m_meshlets_culled = 0;
+  m_faces_culled = 0;
   }
 
 //-----------------------------------------------------------------------------
+Canvas::_ClipRect
+Canvas::_GetCanvasRect()
+  {
+  _ClipRect rect;
+  rect.m_x0 = 0;
+  rect.m_y0 = 0;
+  rect.m_x1 = static_cast<int>(m_width);
+  rect.m_y1 = static_cast<int>(m_height);
+  return rect;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TPoint>
+Canvas::_ClipRect
+Canvas::_GetTriangleBounds(TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3, _ClipRect const& i_rect)
+  {
+  _ClipRect bounds;
+  bounds.m_x0 = std::max<int>(std::min({std::get<0>(i_pt1), std::get<0>(i_pt2), std::get<0>(i_pt3)}), i_rect.m_x0);
+  bounds.m_y0 = std::max<int>(std::min({std::get<1>(i_pt1), std::get<1>(i_pt2), std::get<1>(i_pt3)}), i_rect.m_y0);
+  bounds.m_x1 = std::min<int>(std::max({std::get<0>(i_pt1), std::get<0>(i_pt2), std::get<0>(i_pt3)}) + 1, i_rect.m_x1);
+  bounds.m_y1 = std::min<int>(std::max({std::get<1>(i_pt1), std::get<1>(i_pt2), std::get<1>(i_pt3)}) + 1, i_rect.m_y1);
+  return bounds;
+  }
+
+//-----------------------------------------------------------------------------
+Canvas::_RGB8Row::ImageType
+Canvas::_RGB8Row::Create(DimensionType i_w, DimensionType i_h, Color const& i_color)
+  {
+  ImageType image(i_w, i_h, false);
+  image.Fill(i_color);
+  return image;
+  }
+
+//-----------------------------------------------------------------------------
+inline Canvas::_RGB8Row
+Canvas::_RGB8Row::Get(ImageType& io_image, int i_y)
+  {
+  return _RGB8Row{io_image.GetUniqueRow(i_y)};
+  }
+
+//-----------------------------------------------------------------------------
+inline void
+Canvas::_RGB8Row::Set(int i_x, Color const& i_color) const
+  {
+  mp_pixels[i_x] = i_color;
+  }
+
+//-----------------------------------------------------------------------------
+inline void
+Canvas::_RGB8Row::SetBlock(int i_x, Color const* ip_colors, unsigned int i_mask) const
+  {
+  for(int i = 0; i < HalfSpaceTriangle::BlockSize; ++i)
+    if(i_mask & (1u << i))
+      Set(i_x + i, ip_colors[i]);
+  }
+
+//-----------------------------------------------------------------------------
+Canvas::_RGBA8Row::ImageType
+Canvas::_RGBA8Row::Create(DimensionType i_w, DimensionType i_h, Color const& i_color)
+  {
+  ImageType image(i_w, i_h, false);
+  image.Fill(PackedImage::PixelType::FromRGB(i_color));
+  return image;
+  }
+
+//-----------------------------------------------------------------------------
+inline Canvas::_RGBA8Row
+Canvas::_RGBA8Row::Get(ImageType& io_image, int i_y)
+  {
+  return _RGBA8Row{io_image.GetUniqueRow(i_y)};
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::_RGBA8Row::Read(ImageType const& i_image, int i_y, Color* op_colors)
+  {
+  PackedImage::PixelType const* p_pixels = i_image.GetRow(i_y);
+  for(DimensionType x = 0; x < i_image.GetWidth(); ++x)
+    op_colors[x] = p_pixels[x].ToRGB();
+  }
+
+//-----------------------------------------------------------------------------
+inline void
+Canvas::_RGBA8Row::Set(int i_x, Color const& i_color) const
+  {
+  mp_pixels[i_x] = PackedImage::PixelType::FromRGB(i_color);
+  }
+
+//-----------------------------------------------------------------------------
+// Two 4-pixel registers blended with the coverage mask and stored whole. Rows are padded
+// to the alignment, so the block never ends past the row; a block row lies in a single
+// binning tile, so no other thread writes the pixels blended back.
+inline void
+Canvas::_RGBA8Row::SetBlock(int i_x, Color const* ip_colors, unsigned int i_mask) const
+  {
+#if defined(CANVAS_SSE2)
+  static_assert(HalfSpaceTriangle::BlockSize == 8, "Block rows are expected to fill two SSE registers");
+  alignas(16) PackedImage::PixelType pixels[HalfSpaceTriangle::BlockSize];
+  for(int i = 0; i < HalfSpaceTriangle::BlockSize; ++i)
+    pixels[i] = (i_mask & (1u << i)) ? PackedImage::PixelType::FromRGB(ip_colors[i]) : PackedImage::PixelType();
+
+  __m128i const bits = _mm_setr_epi32(1, 2, 4, 8);
+  __m128i* p_block = reinterpret_cast<__m128i*>(mp_pixels + i_x);
+  for(int half = 0; half < 2; ++half)
+    {
+    __m128i const colors = _mm_load_si128(reinterpret_cast<__m128i const*>(pixels) + half);
+    unsigned int const half_mask = (i_mask >> (4 * half)) & 0xFu;
+    if(half_mask == 0xFu)
+      {
+      _mm_storeu_si128(p_block + half, colors);
+      continue;
+      }
+    if(half_mask == 0)
+      continue;
+    __m128i const mask = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(static_cast<int>(half_mask)), bits), bits);
+    __m128i const old_colors = _mm_loadu_si128(p_block + half);
+    _mm_storeu_si128(p_block + half, _mm_or_si128(_mm_and_si128(mask, colors), _mm_andnot_si128(mask, old_colors)));
+    }
+#else
+  for(int i = 0; i < HalfSpaceTriangle::BlockSize; ++i)
+    if(i_mask & (1u << i))
+      Set(i_x + i, ip_colors[i]);
+#endif
+  }
+
+//-----------------------------------------------------------------------------
+Canvas::_PlanarRGB8Row::ImageType
+Canvas::_PlanarRGB8Row::Create(DimensionType i_w, DimensionType i_h, Color const& i_color)
+  {
+  ImageType image(i_w, i_h, false);
+  image.Fill(i_color);
+  return image;
+  }
+
+//-----------------------------------------------------------------------------
+inline Canvas::_PlanarRGB8Row
+Canvas::_PlanarRGB8Row::Get(ImageType& io_image, int i_y)
+  {
+  _PlanarRGB8Row row;
+  for(std::size_t i = 0; i < PlanarImage::PlanesCount; ++i)
+    row.mp_planes[i] = io_image.GetPlane(i).GetUniqueRow(i_y);
+  return row;
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::_PlanarRGB8Row::Read(ImageType const& i_image, int i_y, Color* op_colors)
+  {
+  for(std::size_t i = 0; i < PlanarImage::PlanesCount; ++i)
+    {
+    Color::ComponentType const* p_components = i_image.GetPlane(i).GetRow(i_y);
+    for(DimensionType x = 0; x < i_image.GetPlane(i).GetWidth(); ++x)
+      op_colors[x][i] = p_components[x];
+    }
+  }
+
+//-----------------------------------------------------------------------------
+inline void
+Canvas::_PlanarRGB8Row::Set(int i_x, Color const& i_color) const
+  {
+  for(std::size_t i = 0; i < PlanarImage::PlanesCount; ++i)
+    mp_planes[i][i_x] = i_color[i];
+  }
+
+//-----------------------------------------------------------------------------
+inline void
+Canvas::_PlanarRGB8Row::SetBlock(int i_x, Color const* ip_colors, unsigned int i_mask) const
+  {
+  for(int i = 0; i < HalfSpaceTriangle::BlockSize; ++i)
+    if(i_mask & (1u << i))
+      Set(i_x + i, ip_colors[i]);
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TColorRow, typename TDepth>
+Canvas::_Target<TColorRow, TDepth>::_Target(DimensionType i_w, DimensionType i_h)
+  : m_color()
+  , m_depth(i_w, i_h, false)
+  , m_hierarchical_z()
+  {
+  Color black;
+  black.Fill(0);
+  m_color = TColorRow::Create(i_w, i_h, black);
+  m_depth.Fill(TDepth::Cleared);
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TColorRow>
+Canvas::_AnyTarget
+Canvas::_CreateTarget(DimensionType i_w, DimensionType i_h, DepthFormat i_depth_format)
+  {
+  switch(i_depth_format)
+    {
+    case DepthFormat::UInt16:
+      return _Target<TColorRow, UInt16Depth>(i_w, i_h);
+    case DepthFormat::Float32:
+      return _Target<TColorRow, Float32ReversedDepth>(i_w, i_h);
+    default:
+      return _Target<TColorRow, Int32Depth>(i_w, i_h);
+    }
+  }
+
+//-----------------------------------------------------------------------------
+Canvas::_AnyTarget
+Canvas::_CreateTarget(DimensionType i_w, DimensionType i_h, PixelFormat i_pixel_format, DepthFormat i_depth_format)
+  {
+  switch(i_pixel_format)
+    {
+    case PixelFormat::RGBA8:
+      return _CreateTarget<_RGBA8Row>(i_w, i_h, i_depth_format);
+    case PixelFormat::PlanarRGB8:
+      return _CreateTarget<_PlanarRGB8Row>(i_w, i_h, i_depth_format);
+    default:
+      return _CreateTarget<_RGB8Row>(i_w, i_h, i_depth_format);
+    }
+  }
+
+//-----------------------------------------------------------------------------
+template<typename F>
+void
+Canvas::_VisitTarget(F i_visitor)
+  {
+  std::visit(i_visitor, m_target);
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::_MakeTargetUnique()
+  {
+  _VisitTarget([](auto& io_target)
+    {
+    io_target.m_color.MakeUnique();
+    io_target.m_depth.MakeUnique();
+    });
+  }
+
+//-----------------------------------------------------------------------------
+// Depth test and write of a single pixel, with the same passes as filled triangles
 bool
-Canvas::_Set(Point const& i_pt, Color const& i_color)
+Canvas::_Set(int i_x, int i_y, int i_z, Color const& i_color, _ClipRect const& i_rect, _Pass i_pass)
   {
-  return _Set(std::get<0>(i_pt), std::get<1>(i_pt), std::get<2>(i_pt), i_color);
+  if(i_x < i_rect.m_x0 || i_x >= i_rect.m_x1
+     || i_y < i_rect.m_y0 || i_y >= i_rect.m_y1)
+    return false;
+
+  bool is_passed = false;
+  _VisitTarget([&](auto& io_target)
+    {
+    using Target = std::decay_t<decltype(io_target)>;
+    auto& depth = io_target.m_depth.GetUniqueRow(i_y)[i_x];
+    auto const z = Target::Depth::Encode(i_z);
+    if(i_pass == _Pass::Shade ? z != depth : z < depth)
+      return;
+
+    if(i_pass != _Pass::Shade)
+      {
+      if(m_hierarchical_z_enabled)
+        io_target.m_hierarchical_z.OnWrite(i_x, i_y, depth, z);
+      depth = z;
+      }
+    if(i_pass != _Pass::DepthOnly)
+      Target::ColorRow::Get(io_target.m_color, i_y).Set(i_x, i_color);
+    is_passed = true;
+    });
+  return is_passed;
   }
 
 //-----------------------------------------------------------------------------
@@ -112,6 +623,31 @@ Canvas::_GetGrayColorFromIntensity(int i_intensity)
 //-----------------------------------------------------------------------------
 void
 Canvas::DrawLine(Point i_pt1, Point i_pt2, Color const& i_color)
+  {
+  m_is_converted_image_outdated = true;
+  if(!m_binning_enabled && !m_deferred_shading_enabled)
+    {
+    _MakeTargetUnique();
+    _DrawLine(i_pt1, i_pt2, i_color, _GetCanvasRect(), _Pass::Color);
+    return;
+    }
+
+  // Recorded like triangles, so binned tiles draw it in submission order
+  _RecordedTriangle line;
+  line.m_bounds = _GetTriangleBounds(i_pt1, i_pt2, i_pt2, _GetCanvasRect());
+  if(line.m_bounds.m_x0 >= line.m_bounds.m_x1 || line.m_bounds.m_y0 >= line.m_bounds.m_y1)
+    return; // Completely outside of the canvas
+
+  line.m_draw = [this, i_pt1, i_pt2, i_color](_ClipRect const& i_rect, _Pass i_pass)
+    {
+    _DrawLine(i_pt1, i_pt2, i_color, i_rect, i_pass);
+    };
+  m_recorded_triangles.emplace_back(std::move(line));
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::_DrawLine(Point i_pt1, Point i_pt2, Color const& i_color, _ClipRect const& i_rect, _Pass i_pass)
   {
   int const dx = std::get<0>(i_pt2) - std::get<0>(i_pt1);
   int const dy = std::get<1>(i_pt2) - std::get<1>(i_pt1);
@@ -126,7 +662,7 @@ Canvas::DrawLine(Point i_pt1, Point i_pt2, Color const& i_color)
     LIIterator<Point, 0> it_line(i_pt1, i_pt2);
     for(it_line.GoToBegin(); ; ++it_line)
       {
-      _Set(*it_line, i_color);
+      _Set(std::get<0>(*it_line), std::get<1>(*it_line), std::get<2>(*it_line), i_color, i_rect, i_pass);
       if(it_line.IsAtEnd())
         break;
       }
@@ -136,7 +672,7 @@ Canvas::DrawLine(Point i_pt1, Point i_pt2, Color const& i_color)
     LIIterator<Point, 1> it_line(i_pt1, i_pt2);
     for(it_line.GoToBegin(); ; ++it_line)
       {
-      _Set(*it_line, i_color);
+      _Set(std::get<0>(*it_line), std::get<1>(*it_line), std::get<2>(*it_line), i_color, i_rect, i_pass);
       if(it_line.IsAtEnd())
         break;
       }
@@ -156,21 +692,72 @@ Canvas::DrawTriangle(Point const& i_pt1, Point const& i_pt2, Point const& i_pt3,
 void
 Canvas::DrawFilledTriangle(Point const& i_pt1, Point const& i_pt2, Point const& i_pt3, Color const& i_color)
   {
-  auto f = [&i_color](DrawHLineIterator<Point> const& i_iter)
+  _SubmitFlatTriangle(i_pt1, i_pt2, i_pt3, i_color);
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::DrawFilledTriangle(Point const& i_pt1, Point const& i_pt2, Point const& i_pt3,
+                           TexturePoint const& i_tx1, TexturePoint const& i_tx2, TexturePoint const& i_tx3, float i_intensity)
+  {
+  _SubmitTexturedTriangle(i_pt1, i_pt2, i_pt3, i_tx1, i_tx2, i_tx3, i_intensity);
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::DrawFilledTriangleGouraud(Point const& i_pt1, Point const& i_pt2, Point const& i_pt3,
+                                  Normal const& i_n1, Normal const& i_n2, Normal const& i_n3)
+  {
+  _SubmitGouraudTriangle(i_pt1, i_pt2, i_pt3, i_n1, i_n2, i_n3);
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::DrawFilledTrianglePhong(Point const& i_pt1, Point const& i_pt2, Point const& i_pt3,
+                                Normal const& i_n1, Normal const& i_n2, Normal const& i_n3)
+  {
+  _SubmitPhongTriangle(i_pt1, i_pt2, i_pt3, i_n1, i_n2, i_n3);
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::DrawFilledTriangleGouraud(Point const& i_pt1, Point const& i_pt2, Point const& i_pt3,
+                                  TexturePoint const& i_tx1, TexturePoint const& i_tx2, TexturePoint const& i_tx3,
+                                  Normal const& i_n1, Normal const& i_n2, Normal const& i_n3)
+  {
+  _SubmitGouraudTriangle(i_pt1, i_pt2, i_pt3, i_tx1, i_tx2, i_tx3, i_n1, i_n2, i_n3);
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::DrawFilledTrianglePhong(Point const& i_pt1, Point const& i_pt2, Point const& i_pt3,
+                                TexturePoint const& i_tx1, TexturePoint const& i_tx2, TexturePoint const& i_tx3,
+                                Normal const& i_n1, Normal const& i_n2, Normal const& i_n3)
+  {
+  _SubmitPhongTriangle(i_pt1, i_pt2, i_pt3, i_tx1, i_tx2, i_tx3, i_n1, i_n2, i_n3);
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TPoint>
+void
+Canvas::_SubmitFlatTriangle(TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3, Color const& i_color)
+  {
+  auto f = [i_color](auto const& i_iter)
     {
     (void) i_iter;
     return i_color;
     };
 
-  _DrawFilledTriangle(&i_pt1, &i_pt2, &i_pt3, f);
+  _SubmitFilledTriangle(i_pt1, i_pt2, i_pt3, f);
   }
 
 //-----------------------------------------------------------------------------
+template<typename TPoint>
 void
-Canvas::DrawFilledTriangle(Point const& i_pt1, Point const& i_pt2, Point const& i_pt3,
-                           TexturePoint const& i_tx1, TexturePoint const& i_tx2, TexturePoint const& i_tx3, float i_intensity)
+Canvas::_SubmitTexturedTriangle(TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3,
+                                TexturePoint const& i_tx1, TexturePoint const& i_tx2, TexturePoint const& i_tx3, float i_intensity)
   {
-  using PointWithTexture = Geometry::Point<int, 5>;
+  using PointWithTexture = std::tuple<Point::ValueType, Point::ValueType, _ZType<TPoint>, int, int>;
 
   PointWithTexture pt1(std::get<0>(i_pt1), std::get<1>(i_pt1), std::get<2>(i_pt1), 
                        static_cast<int>(std::get<0>(i_tx1) * m_texture_image.GetWidth()),
@@ -182,45 +769,47 @@ Canvas::DrawFilledTriangle(Point const& i_pt1, Point const& i_pt2, Point const&
                        static_cast<int>(std::get<0>(i_tx3) * m_texture_image.GetWidth()),
                        static_cast<int>(std::get<1>(i_tx3) * m_texture_image.GetHeight()));
 
-  auto f = [this, i_intensity](DrawHLineIterator<PointWithTexture> const& i_iter)
+  auto f = [this, i_intensity](auto const& i_iter)
     {
-    auto texture_x = i_iter.Get<2>();
-    auto texture_y = i_iter.Get<3>();
+    auto texture_x = i_iter.template Get<2>();
+    auto texture_y = i_iter.template Get<3>();
     return _GetColorFromTexture(texture_x, texture_y, i_intensity);
     };
 
-  _DrawFilledTriangle(&pt1, &pt2, &pt3, f);
+  _SubmitFilledTriangle(pt1, pt2, pt3, f);
   }
 
 //-----------------------------------------------------------------------------
+template<typename TPoint>
 void
-Canvas::DrawFilledTriangleGouraud(Point const& i_pt1, Point const& i_pt2, Point const& i_pt3,
-                                  Normal const& i_n1, Normal const& i_n2, Normal const& i_n3)
+Canvas::_SubmitGouraudTriangle(TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3,
+                               Normal const& i_n1, Normal const& i_n2, Normal const& i_n3)
   {
-  using PointWithIntensity = std::tuple<Point::ValueType, Point::ValueType, Point::ValueType, Normal::ValueType>;
+  using PointWithIntensity = std::tuple<Point::ValueType, Point::ValueType, _ZType<TPoint>, Normal::ValueType>;
 
   PointWithIntensity pt1(std::get<0>(i_pt1), std::get<1>(i_pt1), std::get<2>(i_pt1), _GetIntensityFromNormal(i_n1));
   PointWithIntensity pt2(std::get<0>(i_pt2), std::get<1>(i_pt2), std::get<2>(i_pt2), _GetIntensityFromNormal(i_n2));
   PointWithIntensity pt3(std::get<0>(i_pt3), std::get<1>(i_pt3), std::get<2>(i_pt3), _GetIntensityFromNormal(i_n3));
 
-  auto f = [this](DrawHLineIterator<PointWithIntensity> const& i_iter)
+  auto f = [this](auto const& i_iter)
     {
-    auto intensity = i_iter.Get<2>();
+    auto intensity = i_iter.template Get<2>();
     Color color;
     for(std::size_t i = 0; i < 3; ++i)
       color[i] = intensity * 255;
     return color;
     };
 
-  _DrawFilledTriangle(&pt1, &pt2, &pt3, f);
+  _SubmitFilledTriangle(pt1, pt2, pt3, f);
   }
 
 //-----------------------------------------------------------------------------
+template<typename TPoint>
 void
-Canvas::DrawFilledTrianglePhong(Point const& i_pt1, Point const& i_pt2, Point const& i_pt3,
-                                Normal const& i_n1, Normal const& i_n2, Normal const& i_n3)
+Canvas::_SubmitPhongTriangle(TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3,
+                             Normal const& i_n1, Normal const& i_n2, Normal const& i_n3)
   {
-  using PointWithNormal = std::tuple<Point::ValueType, Point::ValueType, Point::ValueType,
+  using PointWithNormal = std::tuple<Point::ValueType, Point::ValueType, _ZType<TPoint>,
                                      Normal::ValueType, Normal::ValueType, Normal::ValueType>;
 
   PointWithNormal pt1(std::get<0>(i_pt1), std::get<1>(i_pt1), std::get<2>(i_pt1),
@@ -230,9 +819,9 @@ Canvas::DrawFilledTrianglePhong(Point const& i_pt1, Point const& i_pt2, Point co
   PointWithNormal pt3(std::get<0>(i_pt3), std::get<1>(i_pt3), std::get<2>(i_pt3),
                       std::get<0>(i_n3), std::get<1>(i_n3), std::get<2>(i_n3));
 
-  auto f = [this](DrawHLineIterator<PointWithNormal> const& i_iter)
+  auto f = [this](auto const& i_iter)
     {
-    Normal normal(i_iter.Get<2>(), i_iter.Get<3>(), i_iter.Get<4>());
+    Normal normal(i_iter.template Get<2>(), i_iter.template Get<3>(), i_iter.template Get<4>());
     auto intensity = _GetIntensityFromNormal(normal);
     Color color;
     for(std::size_t i = 0; i < 3; ++i)
@@ -240,16 +829,17 @@ Canvas::DrawFilledTrianglePhong(Point const& i_pt1, Point const& i_pt2, Point co
     return color;
     };
 
-  _DrawFilledTriangle(&pt1, &pt2, &pt3, f);
+  _SubmitFilledTriangle(pt1, pt2, pt3, f);
   }
 
 //-----------------------------------------------------------------------------
+template<typename TPoint>
 void
-Canvas::DrawFilledTriangleGouraud(Point const& i_pt1, Point const& i_pt2, Point const& i_pt3,
-                                  TexturePoint const& i_tx1, TexturePoint const& i_tx2, TexturePoint const& i_tx3,
-                                  Normal const& i_n1, Normal const& i_n2, Normal const& i_n3)
+Canvas::_SubmitGouraudTriangle(TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3,
+                               TexturePoint const& i_tx1, TexturePoint const& i_tx2, TexturePoint const& i_tx3,
+                               Normal const& i_n1, Normal const& i_n2, Normal const& i_n3)
   {
-  using PointWithTextureAndIntensity = std::tuple<Point::ValueType, Point::ValueType, Point::ValueType, 
+  using PointWithTextureAndIntensity = std::tuple<Point::ValueType, Point::ValueType, _ZType<TPoint>, 
     int, int, Normal::ValueType>;
 
   PointWithTextureAndIntensity pt1(std::get<0>(i_pt1), std::get<1>(i_pt1), std::get<2>(i_pt1),
@@ -265,24 +855,25 @@ Canvas::DrawFilledTriangleGouraud(Point const& i_pt1, Point const& i_pt2, Point
                                 static_cast<int>(std::get<1>(i_tx3) * m_texture_image.GetHeight()),
                                 _GetIntensityFromNormal(i_n3));
 
-  auto f = [this](DrawHLineIterator<PointWithTextureAndIntensity> const& i_iter)
+  auto f = [this](auto const& i_iter)
     {
-    auto texture_x = i_iter.Get<2>();
-    auto texture_y = i_iter.Get<3>();
-    auto intensity = i_iter.Get<4>();
+    auto texture_x = i_iter.template Get<2>();
+    auto texture_y = i_iter.template Get<3>();
+    auto intensity = i_iter.template Get<4>();
     return _GetColorFromTexture(texture_x, texture_y, intensity);
     };
 
-  _DrawFilledTriangle(&pt1, &pt2, &pt3, f);
+  _SubmitFilledTriangle(pt1, pt2, pt3, f);
   }
 
 //-----------------------------------------------------------------------------
+template<typename TPoint>
 void
-Canvas::DrawFilledTrianglePhong(Point const& i_pt1, Point const& i_pt2, Point const& i_pt3,
-                                TexturePoint const& i_tx1, TexturePoint const& i_tx2, TexturePoint const& i_tx3,
-                                Normal const& i_n1, Normal const& i_n2, Normal const& i_n3)
+Canvas::_SubmitPhongTriangle(TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3,
+                             TexturePoint const& i_tx1, TexturePoint const& i_tx2, TexturePoint const& i_tx3,
+                             Normal const& i_n1, Normal const& i_n2, Normal const& i_n3)
   {
-  using PointWithTextureAndNormal = std::tuple<Point::ValueType, Point::ValueType, Point::ValueType, 
+  using PointWithTextureAndNormal = std::tuple<Point::ValueType, Point::ValueType, _ZType<TPoint>, 
     int, int, Normal::ValueType, Normal::ValueType, Normal::ValueType>;
 
   PointWithTextureAndNormal pt1(std::get<0>(i_pt1), std::get<1>(i_pt1), std::get<2>(i_pt1),
@@ -298,21 +889,119 @@ Canvas::DrawFilledTrianglePhong(Point const& i_pt1, Point const& i_pt2, Point co
                                 static_cast<int>(std::get<1>(i_tx3) * m_texture_image.GetHeight()),
                                 std::get<0>(i_n3), std::get<1>(i_n3), std::get<2>(i_n3));
 
-  auto f = [this](DrawHLineIterator<PointWithTextureAndNormal> const& i_iter)
+  auto f = [this](auto const& i_iter)
     {
-    auto texture_x = i_iter.Get<2>();
-    auto texture_y = i_iter.Get<3>();
-    Normal normal(i_iter.Get<4>(), i_iter.Get<5>(), i_iter.Get<6>());
+    auto texture_x = i_iter.template Get<2>();
+    auto texture_y = i_iter.template Get<3>();
+    Normal normal(i_iter.template Get<4>(), i_iter.template Get<5>(), i_iter.template Get<6>());
     auto intensity = _GetIntensityFromNormal(normal);
     return _GetColorFromTexture(texture_x, texture_y, intensity);
     };
 
-  _DrawFilledTriangle(&pt1, &pt2, &pt3, f);
+  _SubmitFilledTriangle(pt1, pt2, pt3, f);
   }
 
 //-----------------------------------------------------------------------------
-template<typename TPoint, typename F>
-void Canvas::_DrawHLine(TPoint const& i_pt1, TPoint const& i_pt2, F i_color_getter)
+void
+Canvas::DrawMesh(Mesh const& i_mesh, Transform const& i_transform, ShadingMode i_shading_mode)
+  {
+  _DrawMesh(i_mesh, nullptr, nullptr, i_transform, i_shading_mode);
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::DrawMesh(CompactMesh const& i_mesh, Transform const& i_transform, ShadingMode i_shading_mode)
+  {
+  _DrawMesh(i_mesh, nullptr, nullptr, i_transform, i_shading_mode);
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::DrawMesh(MappedMesh const& i_mesh, Transform const& i_transform, ShadingMode i_shading_mode)
+  {
+  _DrawMesh(i_mesh, nullptr, nullptr, i_transform, i_shading_mode);
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::DrawMesh(Mesh const& i_mesh, Meshlets const& i_meshlets, Transform const& i_transform, ShadingMode i_shading_mode)
+  {
+  _DrawMesh(i_mesh, &i_meshlets, nullptr, i_transform, i_shading_mode);
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::DrawMesh(CompactMesh const& i_mesh, Meshlets const& i_meshlets, Transform const& i_transform, ShadingMode i_shading_mode)
+  {
+  _DrawMesh(i_mesh, &i_meshlets, nullptr, i_transform, i_shading_mode);
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::DrawMesh(Mesh const& i_mesh, MeshHierarchy const& i_hierarchy, Transform const& i_transform, ShadingMode i_shading_mode)
+  {
+  _DrawMesh(i_mesh, nullptr, &i_hierarchy, i_transform, i_shading_mode);
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::DrawMesh(CompactMesh const& i_mesh, MeshHierarchy const& i_hierarchy, Transform const& i_transform, ShadingMode i_shading_mode)
+  {
+  _DrawMesh(i_mesh, nullptr, &i_hierarchy, i_transform, i_shading_mode);
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::DrawMeshStreamed(MappedMesh const& i_mesh, Transform const& i_transform, ShadingMode i_shading_mode,
+                         std::size_t i_chunk_faces_count)
+  {
+  auto const& faces = i_mesh.faces();
+  i_chunk_faces_count = std::max<std::size_t>(i_chunk_faces_count, 1);
+  for(std::size_t first = 0; first < faces.size(); first += i_chunk_faces_count)
+    {
+    std::size_t const last = std::min(first + i_chunk_faces_count, faces.size());
+
+    _GatherFaceVertices(i_mesh, last - first, [first](std::size_t i) { return first + i; });
+    _TransformMeshVertices(&m_chunk_vertices[0][0], 3, m_chunk_vertices.size(), i_transform);
+    for(std::size_t i = first; i < last; ++i)
+      {
+      std::uint32_t const* p_indices = &m_chunk_indices[3 * (i - first)];
+      auto const& face = faces[i];
+      _DrawMeshTriangle(p_indices[0], p_indices[1], p_indices[2], i_shading_mode,
+                        [&](std::size_t i_corner) -> WorldPoint const& { return m_chunk_vertices[p_indices[i_corner]]; },
+                        [&](std::size_t i_corner) -> TexturePoint const& { return i_mesh.texture(face[1][i_corner]); },
+                        [&](std::size_t i_corner) -> Normal const& { return i_mesh.normal(face[2][i_corner]); });
+      }
+    Flush(); // recorded triangles would grow with the mesh otherwise
+    }
+  }
+
+//-----------------------------------------------------------------------------
+void
+Canvas::DrawMesh(IndexedMesh const& i_mesh, Transform const& i_transform, ShadingMode i_shading_mode)
+  {
+  using Vertex = IndexedMesh::Vertex;
+  static_assert(sizeof(Vertex) % sizeof(float) == 0 && sizeof(WorldPoint) == 3 * sizeof(float),
+                "Indexed mesh vertices are expected to be made of floats");
+  auto const& vertices = i_mesh.vertices();
+  auto const& indices = i_mesh.indices();
+  _TransformMeshVertices(vertices.empty() ? nullptr : &vertices[0].m_position[0], sizeof(Vertex) / sizeof(float),
+                         vertices.size(), i_transform);
+
+  for(std::size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+    IndexedMesh::Index const* p_triangle = &indices[i];
+    _DrawMeshTriangle(p_triangle[0], p_triangle[1], p_triangle[2], i_shading_mode,
+                      [&](std::size_t i_corner) -> WorldPoint const& { return vertices[p_triangle[i_corner]].m_position; },
+                      [&](std::size_t i_corner) -> TexturePoint const& { return vertices[p_triangle[i_corner]].m_texture; },
+                      [&](std::size_t i_corner) -> Normal const& { return vertices[p_triangle[i_corner]].m_normal; });
+    }
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TTarget, typename TPoint, typename F>
+void Canvas::_DrawHLine(TTarget& io_target, TPoint const& i_pt1, TPoint const& i_pt2, F i_color_getter, _ClipRect const& i_rect,
+                        _Pass i_pass)
   {
   static_assert(std::tuple_size<TPoint>::value >= 3, "_DrawHLine is possible only for 3D+ points");
 
@@ -322,13 +1011,63 @@ void Canvas::_DrawHLine(TPoint const& i_pt1, TPoint const& i_pt2, F i_color_gett
   // Small optimization. Because of it is Horizontal Line, Y is const. 
   // No sence to iterate over it. Remember it and iterate in N-1 direction.
   int const y = std::get<1>(i_pt1);
+  if(y < i_rect.m_y0 || y >= i_rect.m_y1)
+    return;
+
+  // Clip the span once instead of checking bounds for every pixel
+  int const x_begin = std::get<0>(i_pt1);
+  int const x_first = std::max(x_begin, i_rect.m_x0);
+  int const x_last = std::min(std::get<0>(i_pt2), i_rect.m_x1 - 1);
+  if(x_first > x_last)
+    return;
+
   auto shrinked_pt1 = std::RemoveItem<1>(i_pt1);
   auto shrinked_pt2 = std::RemoveItem<1>(i_pt2);
   DrawHLineIterator<TPoint> it_line(shrinked_pt1, shrinked_pt2);
-  for(it_line.GoToBegin(); ; ++it_line)
+  it_line.GoToBegin();
+  for(int x = x_begin; x < x_first; ++x) // Interpolation is incremental, so walk through clipped pixels
+    ++it_line;
+
+  // z is interpolated linearly, so no pixel of the span is closer than its closest end;
+  // float z is clamped to it, rounding of the steps may overshoot
+  using Depth = typename TTarget::Depth;
+  using DepthType = typename Depth::ValueType;
+  Graphics::Image<DepthType>& depth_buffer = io_target.m_depth;
+  HierarchicalZBuffer<DepthType>* p_hierarchical_z = m_hierarchical_z_enabled ? &io_target.m_hierarchical_z : nullptr;
+  DepthType const span_z_max = Depth::Encode(std::max(std::get<2>(i_pt1), std::get<2>(i_pt2)));
+  int const tile_y = y >> _HierarchicalZ::TileShift;
+
+  typename TTarget::ColorRow const color_row = TTarget::ColorRow::Get(io_target.m_color, y);
+  DepthType* p_depths = depth_buffer.GetUniqueRow(y);
+  for(int x = x_first; ; ++x, ++it_line)
     {
-    _Set(it_line.Get<0>(), y, it_line.Get<1>(), i_color_getter(it_line));
-    if(it_line.IsAtEnd())
+    if(p_hierarchical_z && (x == x_first || (x & _HierarchicalZ::TileMask) == 0)
+       && p_hierarchical_z->IsOccluded(x >> _HierarchicalZ::TileShift, tile_y, span_z_max, depth_buffer))
+      {
+      // Rest of the span inside this tile is hidden: move to its last pixel
+      int const x_tile_last = std::min(x | _HierarchicalZ::TileMask, x_last);
+      for(; x < x_tile_last; ++x)
+        ++it_line;
+      if(x == x_last)
+        break;
+      continue;
+      }
+
+    DepthType const z = std::min(Depth::Encode(it_line.Get<1>()), span_z_max);
+    if(i_pass == _Pass::Shade)
+      {
+      if(z == p_depths[x])
+        color_row.Set(x, i_color_getter(it_line));
+      }
+    else if(z >= p_depths[x])
+      {
+      if(p_hierarchical_z)
+        p_hierarchical_z->OnWrite(x, y, p_depths[x], z);
+      if(i_pass == _Pass::Color)
+        color_row.Set(x, i_color_getter(it_line));
+      p_depths[x] = z;
+      }
+    if(x == x_last)
       break;
     }
   }
@@ -336,7 +1075,94 @@ void Canvas::_DrawHLine(TPoint const& i_pt1, TPoint const& i_pt2, F i_color_gett
 //-----------------------------------------------------------------------------
 template<typename TPoint, typename F>
 void
-Canvas::_DrawFilledTriangle(TPoint const* ip_pt1, TPoint const* ip_pt2, TPoint const* ip_pt3, F i_color_getter)
+Canvas::_SubmitFilledTriangle(TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3, F i_color_getter)
+  {
+  m_is_converted_image_outdated = true;
+  if(!m_binning_enabled && !m_deferred_shading_enabled)
+    {
+    _MakeTargetUnique();
+    _DrawFilledTriangle(&i_pt1, &i_pt2, &i_pt3, i_color_getter, _GetCanvasRect(), _Pass::Color);
+    return;
+    }
+
+  _RecordedTriangle triangle;
+  triangle.m_bounds = _GetTriangleBounds(i_pt1, i_pt2, i_pt3, _GetCanvasRect());
+  if(triangle.m_bounds.m_x0 >= triangle.m_bounds.m_x1 || triangle.m_bounds.m_y0 >= triangle.m_bounds.m_y1)
+    return; // Completely outside of the canvas
+
+  // Points and color getter are captured by value: triangle is set up once and drawn per tile and pass later
+  triangle.m_draw = [this, pt1 = i_pt1, pt2 = i_pt2, pt3 = i_pt3, i_color_getter](_ClipRect const& i_rect, _Pass i_pass)
+    {
+    _DrawFilledTriangle(&pt1, &pt2, &pt3, i_color_getter, i_rect, i_pass);
+    };
+  m_recorded_triangles.emplace_back(std::move(triangle));
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TPoint, typename F>
+void
+Canvas::_DrawFilledTriangle(TPoint const* ip_pt1, TPoint const* ip_pt2, TPoint const* ip_pt3, F i_color_getter,
+                            _ClipRect const& i_rect, _Pass i_pass)
+  {
+  _VisitTarget([&](auto& io_target)
+    {
+    // Float z is only submitted for float depth, int targets are not instantiated for it
+    using Depth = typename std::decay_t<decltype(io_target)>::Depth;
+    if constexpr(std::is_integral<_ZType<TPoint>>::value || !std::is_integral<typename Depth::ZType>::value)
+      {
+      if(m_hierarchical_z_enabled && _IsOccluded(io_target, *ip_pt1, *ip_pt2, *ip_pt3, i_rect, i_pass))
+        return;
+
+      if(m_rasterizer == Rasterizer::HalfSpace)
+        _DrawFilledTriangleHalfSpace(io_target, ip_pt1, ip_pt2, ip_pt3, i_color_getter, i_rect, i_pass);
+      else
+        _DrawFilledTriangleScanline(io_target, ip_pt1, ip_pt2, ip_pt3, i_color_getter, i_rect, i_pass);
+      }
+    });
+  }
+
+//-----------------------------------------------------------------------------
+// Tests the triangle against hierarchical Z tiles covered by its bounding box in i_rect
+template<typename TTarget, typename TPoint>
+bool
+Canvas::_IsOccluded(TTarget& io_target, TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3, _ClipRect const& i_rect,
+                    _Pass i_pass)
+  {
+  _ClipRect const bounds = _GetTriangleBounds(i_pt1, i_pt2, i_pt3, i_rect);
+  if(bounds.m_x0 >= bounds.m_x1 || bounds.m_y0 >= bounds.m_y1)
+    return true; // Nothing to draw in this rect anyway, not counted
+
+  using Depth = typename TTarget::Depth;
+  typename Depth::ValueType const z_max = Depth::Encode(std::max({std::get<2>(i_pt1), std::get<2>(i_pt2), std::get<2>(i_pt3)}));
+  HierarchicalZBuffer<typename Depth::ValueType>& hierarchical_z = io_target.m_hierarchical_z;
+  std::size_t tiles_count = 0;
+  std::size_t occluded_count = 0;
+  for(int tile_y = bounds.m_y0 >> _HierarchicalZ::TileShift; tile_y <= (bounds.m_y1 - 1) >> _HierarchicalZ::TileShift; ++tile_y)
+    for(int tile_x = bounds.m_x0 >> _HierarchicalZ::TileShift; tile_x <= (bounds.m_x1 - 1) >> _HierarchicalZ::TileShift; ++tile_x)
+      {
+      ++tiles_count;
+      if(hierarchical_z.IsOccluded(tile_x, tile_y, z_max, io_target.m_depth))
+        ++occluded_count;
+      }
+
+  // Shading pass revisits triangles of the depth pass, count them only once
+  bool const is_counted = i_pass != _Pass::Shade;
+  if(occluded_count == tiles_count)
+    {
+    if(is_counted)
+      ++m_triangles_culled;
+    return true;
+    }
+  if(is_counted && occluded_count != 0)
+    m_tiles_culled += occluded_count;
+  return false;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TTarget, typename TPoint, typename F>
+void
+Canvas::_DrawFilledTriangleScanline(TTarget& io_target, TPoint const* ip_pt1, TPoint const* ip_pt2, TPoint const* ip_pt3,
+                                    F i_color_getter, _ClipRect const& i_rect, _Pass i_pass)
   {
   _Sort3PointsInDirection<1>(ip_pt1, ip_pt2, ip_pt3);
 
@@ -347,7 +1173,7 @@ Canvas::_DrawFilledTriangle(TPoint const* ip_pt1, TPoint const* ip_pt2, TPoint c
     if(std::get<0>(*ip_pt1) == std::get<0>(*ip_pt3)) // All 3 points merges to a point. Draw the point
       {
       _Sort3PointsInDirection<2>(ip_pt1, ip_pt2, ip_pt3);
-      _DrawHLine(*ip_pt3, *ip_pt3, i_color_getter);
+      _DrawHLine(io_target, *ip_pt3, *ip_pt3, i_color_getter, i_rect, i_pass);
       return;
       }
 
@@ -357,12 +1183,12 @@ Canvas::_DrawFilledTriangle(TPoint const* ip_pt1, TPoint const* ip_pt2, TPoint c
       * (std::get<0>(*ip_pt2) - std::get<0>(*ip_pt1)) / (std::get<0>(*ip_pt3) - std::get<0>(*ip_pt1));
     if(z13_x2 >= std::get<2>(*ip_pt2)) // No sence to draw 2 another lines. This line is upper by Z
       {
-      _DrawHLine(*ip_pt1, *ip_pt3, i_color_getter);
+      _DrawHLine(io_target, *ip_pt1, *ip_pt3, i_color_getter, i_rect, i_pass);
       }
     else // No sence to draw another line. These 2 lines are upper by Z
       {
-      _DrawHLine(*ip_pt1, *ip_pt2, i_color_getter);
-      _DrawHLine(*ip_pt2, *ip_pt3, i_color_getter);
+      _DrawHLine(io_target, *ip_pt1, *ip_pt2, i_color_getter, i_rect, i_pass);
+      _DrawHLine(io_target, *ip_pt2, *ip_pt3, i_color_getter, i_rect, i_pass);
       }
     return;
     }
@@ -380,10 +1206,10 @@ Canvas::_DrawFilledTriangle(TPoint const* ip_pt1, TPoint const* ip_pt2, TPoint c
     LIIterator<TPoint, 1> it_line_right(*ip_pt1, *ip_pt3);       it_line_right.GoToBegin();
 
     for(; !it_line_left_bottom.IsAtEnd(); ++it_line_left_bottom, ++it_line_right)
-      _DrawHLine(*it_line_left_bottom, *it_line_right, i_color_getter);
+      _DrawHLine(io_target, *it_line_left_bottom, *it_line_right, i_color_getter, i_rect, i_pass);
     for(; ; ++it_line_left_top, ++it_line_right)
       {
-      _DrawHLine(*it_line_left_top, *it_line_right, i_color_getter);
+      _DrawHLine(io_target, *it_line_left_top, *it_line_right, i_color_getter, i_rect, i_pass);
       if(it_line_left_top.IsAtEnd())
         break;
       }
@@ -395,16 +1221,333 @@ Canvas::_DrawFilledTriangle(TPoint const* ip_pt1, TPoint const* ip_pt2, TPoint c
     LIIterator<TPoint, 1> it_line_left(*ip_pt1, *ip_pt3);         it_line_left.GoToBegin();
 
     for(; !it_line_right_bottom.IsAtEnd(); ++it_line_left, ++it_line_right_bottom)
-      _DrawHLine(*it_line_left, *it_line_right_bottom, i_color_getter);
+      _DrawHLine(io_target, *it_line_left, *it_line_right_bottom, i_color_getter, i_rect, i_pass);
     for(; ; ++it_line_left, ++it_line_right_top)
       {
-      _DrawHLine(*it_line_left, *it_line_right_top, i_color_getter);
+      _DrawHLine(io_target, *it_line_left, *it_line_right_top, i_color_getter, i_rect, i_pass);
       if(it_line_right_top.IsAtEnd())
         break;
       }
     }
   }
 
+//-----------------------------------------------------------------------------
+template<typename TTarget, typename TPoint, typename F>
+void
+Canvas::_DrawFilledTriangleHalfSpace(TTarget& io_target, TPoint const* ip_pt1, TPoint const* ip_pt2, TPoint const* ip_pt3,
+                                     F i_color_getter, _ClipRect const& i_rect, _Pass i_pass)
+  {
+  HalfSpaceTriangle triangle;
+  if(!triangle.Setup(std::get<0>(*ip_pt1), std::get<1>(*ip_pt1),
+                     std::get<0>(*ip_pt2), std::get<1>(*ip_pt2),
+                     std::get<0>(*ip_pt3), std::get<1>(*ip_pt3)))
+    {
+    // Degenerated triangle is a line or a point, scanline rasterizer knows how to draw them
+    _DrawFilledTriangleScanline(io_target, ip_pt1, ip_pt2, ip_pt3, i_color_getter, i_rect, i_pass);
+    return;
+    }
+  if(triangle.IsSwapped())
+    std::swap(ip_pt2, ip_pt3);
+
+  _ClipRect const bounds = _GetTriangleBounds(*ip_pt1, *ip_pt2, *ip_pt3, i_rect);
+  int const x_min = bounds.m_x0;
+  int const y_min = bounds.m_y0;
+  int const x_max = bounds.m_x1;
+  int const y_max = bounds.m_y1;
+  if(x_min >= x_max || y_min >= y_max)
+    return;
+
+  static_assert(HalfSpaceTriangle::BlockSize == _HierarchicalZ::TileSize, "Blocks are expected to match hierarchical Z tiles");
+  using Depth = typename TTarget::Depth;
+  using DepthType = typename Depth::ValueType;
+  Graphics::Image<DepthType>& depth_buffer = io_target.m_depth;
+  HierarchicalZBuffer<DepthType>* p_hierarchical_z = m_hierarchical_z_enabled ? &io_target.m_hierarchical_z : nullptr;
+  auto const z_closest = std::max({std::get<2>(*ip_pt1), std::get<2>(*ip_pt2), std::get<2>(*ip_pt3)});
+  DepthType const z_max = Depth::Encode(z_closest);
+
+  using Attributes = std::make_index_sequence<std::tuple_size<TPoint>::value - 2>;
+  int const block_size = HalfSpaceTriangle::BlockSize;
+  float const inversed_area = 1.f / triangle.GetDoubleArea();
+  auto const& edge2 = triangle.GetEdge(1); // weight of the 2nd point
+  auto const& edge3 = triangle.GetEdge(2); // weight of the 3rd point
+
+  HalfSpaceFragment<TPoint> fragment;
+  for(int block_y = y_min & ~(block_size - 1); block_y < y_max; block_y += block_size)
+    for(int block_x = x_min & ~(block_size - 1); block_x < x_max; block_x += block_size)
+      {
+      std::uint64_t const mask = triangle.GetBlockCoverage(block_x, block_y);
+      if(mask == 0)
+        continue;
+      if(p_hierarchical_z && p_hierarchical_z->IsOccluded(block_x >> _HierarchicalZ::TileShift, block_y >> _HierarchicalZ::TileShift,
+                                                          z_max, depth_buffer))
+        continue;
+
+      // Columns of the block outside of the bounds
+      unsigned int columns_mask = 0xFF;
+      if(block_x < x_min)
+        columns_mask &= 0xFFu << (x_min - block_x);
+      if(block_x + block_size > x_max)
+        columns_mask &= 0xFFu >> (block_x + block_size - x_max);
+
+      for(int row = 0; row < block_size; ++row)
+        {
+        int const y = block_y + row;
+        unsigned int row_mask = static_cast<unsigned int>(mask >> (row * block_size)) & columns_mask;
+        if(row_mask == 0 || y < y_min || y >= y_max)
+          continue;
+
+        // Depth test goes first and for the whole row at once, so hidden fragments are not shaded at all.
+        // Rows of depth images are padded to the alignment, so all 8 values of a block row can be read.
+        DepthType* p_depths = depth_buffer.GetUniqueRow(y);
+        typename Depth::ZType z[HalfSpaceTriangle::BlockSize];
+        InterpolateBlockRowDepth(z, block_x, y, *ip_pt1, *ip_pt2, *ip_pt3, edge2, edge3, inversed_area);
+        for(auto& z_item : z) // Float rounding may overshoot the closest vertex, hierarchical Z relies on it
+          z_item = std::min(z_item, static_cast<typename Depth::ZType>(z_closest));
+        row_mask &= Depth::TestBlockRow(p_depths + block_x, z, i_pass == _Pass::Shade);
+        if(row_mask == 0)
+          continue;
+
+        Color colors[HalfSpaceTriangle::BlockSize]; // shaded fragments of the row, stored at once
+        for(int column = 0; column < block_size; ++column)
+          {
+          if((row_mask & (1u << column)) == 0)
+            continue;
+
+          int const x = block_x + column;
+          if(i_pass != _Pass::Shade)
+            {
+            DepthType const depth = Depth::Encode(z[column]);
+            if(p_hierarchical_z)
+              p_hierarchical_z->OnWrite(x, y, p_depths[x], depth);
+            p_depths[x] = depth;
+            if(i_pass == _Pass::DepthOnly)
+              continue;
+            }
+
+          std::get<0>(fragment.m_point) = x;
+          std::get<1>(fragment.m_point) = y;
+          InterpolateAttributes(fragment.m_point, *ip_pt1, *ip_pt2, *ip_pt3,
+                                edge2.Evaluate(x, y) * inversed_area, edge3.Evaluate(x, y) * inversed_area,
+                                Attributes());
+          std::get<2>(fragment.m_point) = static_cast<_ZType<TPoint>>(z[column]);
+          colors[column] = i_color_getter(fragment);
+          }
+        if(i_pass != _Pass::DepthOnly)
+          TTarget::ColorRow::Get(io_target.m_color, y).SetBlock(block_x, colors, row_mask);
+        }
+      }
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TMesh>
+void
+Canvas::_DrawMesh(TMesh const& i_mesh, Meshlets const* ip_meshlets, MeshHierarchy const* ip_hierarchy,
+                  Transform const& i_transform, ShadingMode i_shading_mode)
+  {
+  auto const& vertices = i_mesh.vertices();
+  static_assert(sizeof(vertices[0]) == 3 * sizeof(float), "Mesh vertices are expected to be packed float x, y, z");
+  auto const& faces = i_mesh.faces();
+  Normal const* p_face_normals = Geometry::GetPrecomputedFaceNormals(i_mesh);
+
+  if(ip_hierarchy != nullptr)
+    {
+    assert(ip_hierarchy->GetFacesCount() == faces.size());
+    m_visible_faces.clear();
+    ip_hierarchy->QueryFrustum(MeshHierarchy::GetFrustum(i_transform, static_cast<int>(m_width), static_cast<int>(m_height)),
+                               [&](std::size_t i_face)
+      {
+      m_visible_faces.push_back(i_face);
+      });
+    m_faces_culled += faces.size() - m_visible_faces.size();
+    if(m_visible_faces.empty())
+      return;
+
+    // Mesh order keeps the image the same as without the hierarchy; only vertices of visible faces are transformed
+    std::sort(m_visible_faces.begin(), m_visible_faces.end());
+    _GatherFaceVertices(i_mesh, m_visible_faces.size(), [this](std::size_t i) { return m_visible_faces[i]; });
+    _TransformMeshVertices(&m_chunk_vertices[0][0], 3, m_chunk_vertices.size(), i_transform);
+    for(std::size_t i = 0; i < m_visible_faces.size(); ++i)
+      {
+      std::uint32_t const* p_indices = &m_chunk_indices[3 * i];
+      std::size_t const face_idx = m_visible_faces[i];
+      auto const& texture_indices = std::get<1>(faces[face_idx]);
+      auto const& normal_indices = std::get<2>(faces[face_idx]);
+      _DrawMeshTriangle(p_indices[0], p_indices[1], p_indices[2], i_shading_mode,
+                        [&](std::size_t i_corner) -> WorldPoint const& { return m_chunk_vertices[p_indices[i_corner]]; },
+                        [&](std::size_t i_corner) -> TexturePoint const& { return i_mesh.texture(texture_indices[i_corner]); },
+                        [&](std::size_t i_corner) -> Normal const& { return i_mesh.normal(normal_indices[i_corner]); },
+                        p_face_normals != nullptr ? p_face_normals + face_idx : nullptr);
+      }
+    return;
+    }
+
+  _TransformMeshVertices(vertices.empty() ? nullptr : &vertices[0][0], 3, vertices.size(), i_transform);
+  auto const draw_faces = [&](std::size_t i_first, std::size_t i_last)
+    {
+    for(std::size_t i = i_first; i < i_last; ++i)
+      {
+      auto const& vertex_indices = std::get<0>(faces[i]);
+      auto const& texture_indices = std::get<1>(faces[i]);
+      auto const& normal_indices = std::get<2>(faces[i]);
+      _DrawMeshTriangle(vertex_indices[0], vertex_indices[1], vertex_indices[2], i_shading_mode,
+                        [&](std::size_t i_corner) -> WorldPoint const& { return vertices[vertex_indices[i_corner]]; },
+                        [&](std::size_t i_corner) -> TexturePoint const& { return i_mesh.texture(texture_indices[i_corner]); },
+                        [&](std::size_t i_corner) -> Normal const& { return i_mesh.normal(normal_indices[i_corner]); },
+                        p_face_normals != nullptr ? p_face_normals + i : nullptr);
+      }
+    };
+
+  if(ip_meshlets == nullptr)
+    {
+    draw_faces(0, faces.size());
+    return;
+    }
+
+  Geometry::MeshletCuller const culler(i_transform, static_cast<int>(m_width), static_cast<int>(m_height));
+  for(Geometry::Meshlet const& meshlet : *ip_meshlets)
+    {
+    if(culler.IsBackFacing(meshlet) || culler.IsOutside(meshlet))
+      {
+      ++m_meshlets_culled;
+      continue;
+      }
+    draw_faces(meshlet.m_first_face, meshlet.m_first_face + meshlet.m_faces_count);
+    }
+  }
+
+//-----------------------------------------------------------------------------
+// Vertex stage: each vertex is transformed once, triangles refer to the results by index
+void
+Canvas::_TransformMeshVertices(float const* ip_positions, std::size_t i_stride, std::size_t i_count, Transform const& i_transform)
+  {
+  m_transformed_vertices.resize(3 * i_count);
+  m_transformed_w.resize(i_count);
+  m_screen_vertices.resize(i_count);
+  m_screen_vertices_valid.resize(i_count);
+
+  Geometry::BatchTransform const batch_transform(i_transform);
+  std::size_t const chunk_size = 1 << 14; // Big meshes are transformed by all threads
+  Global::ParallelFor((i_count + chunk_size - 1) / chunk_size, [&](std::size_t i_chunk)
+    {
+    std::size_t const first = i_chunk * chunk_size;
+    std::size_t const last = std::min(first + chunk_size, i_count);
+    batch_transform.TransformAoS(ip_positions + first * i_stride, i_stride, last - first,
+                                 &m_transformed_vertices[3 * first], &m_transformed_w[first]);
+    for(std::size_t i = first; i < last; ++i)
+      {
+      m_screen_vertices_valid[i] = m_transformed_w[i] > 0.f;
+      if(!m_screen_vertices_valid[i])
+        continue; // Coordinates may be infinite, don't convert them
+      m_screen_vertices[i] = Point(static_cast<int>(m_transformed_vertices[3 * i]),
+                                   static_cast<int>(m_transformed_vertices[3 * i + 1]),
+                                   static_cast<int>(m_transformed_vertices[3 * i + 2]));
+      }
+    }, m_threads_count);
+  }
+
+//-----------------------------------------------------------------------------
+// Distinct mesh vertices of i_faces_count faces (i_face_index maps 0.. to mesh faces) go to
+// m_chunk_vertices in increasing order, to read the mesh forward; m_chunk_indices[3 * i + corner]
+// is the chunk vertex of a corner
+template<typename TMesh, typename FFaceIndex>
+void
+Canvas::_GatherFaceVertices(TMesh const& i_mesh, std::size_t i_faces_count, FFaceIndex i_face_index)
+  {
+  auto const& faces = i_mesh.faces();
+  m_chunk_corners.clear();
+  for(std::size_t i = 0; i < i_faces_count; ++i)
+    {
+    auto const& vertex_indices = std::get<0>(faces[i_face_index(i)]);
+    for(std::size_t corner = 0; corner < 3; ++corner)
+      m_chunk_corners.emplace_back(static_cast<std::uint32_t>(vertex_indices[corner]), static_cast<std::uint32_t>(3 * i + corner));
+    }
+  std::sort(m_chunk_corners.begin(), m_chunk_corners.end());
+  m_chunk_vertices.clear();
+  m_chunk_indices.resize(m_chunk_corners.size());
+  for(std::size_t i = 0; i < m_chunk_corners.size(); ++i)
+    {
+    if(i == 0 || m_chunk_corners[i].first != m_chunk_corners[i - 1].first)
+      m_chunk_vertices.push_back(i_mesh.vertex(m_chunk_corners[i].first));
+    m_chunk_indices[m_chunk_corners[i].second] = static_cast<std::uint32_t>(m_chunk_vertices.size() - 1);
+    }
+  }
+
+//-----------------------------------------------------------------------------
+// Triangle stage: i_v* index results of _TransformMeshVertices, attribute getters
+// take a corner number (0..2) and are called only by modes that need them
+template<typename FWorldPoint, typename FTexturePoint, typename FNormal>
+void
+Canvas::_DrawMeshTriangle(std::size_t i_v1, std::size_t i_v2, std::size_t i_v3, ShadingMode i_shading_mode,
+                          FWorldPoint i_world_point, FTexturePoint i_texture_point, FNormal i_normal,
+                          Normal const* ip_face_normal)
+  {
+  if(!m_screen_vertices_valid[i_v1] || !m_screen_vertices_valid[i_v2] || !m_screen_vertices_valid[i_v3])
+    return;
+
+  Point const& pt1 = m_screen_vertices[i_v1];
+  Point const& pt2 = m_screen_vertices[i_v2];
+  Point const& pt3 = m_screen_vertices[i_v3];
+
+  // Back-face culling: front faces are counter-clockwise on the screen. Edge-on faces are
+  // kept, the rasterizer draws them as the lines or points they project to
+  int const double_area = (std::get<0>(pt2) - std::get<0>(pt1)) * (std::get<1>(pt3) - std::get<1>(pt1))
+                        - (std::get<1>(pt2) - std::get<1>(pt1)) * (std::get<0>(pt3) - std::get<0>(pt1));
+  if(double_area < 0)
+    return;
+
+  // Float depth gets the z of the vertex transform as is, the other formats the truncated one of the screen vertex
+  auto const submit = [&](auto const& i_pt1, auto const& i_pt2, auto const& i_pt3)
+    {
+    switch(i_shading_mode)
+      {
+      case ShadingMode::Flat:
+      case ShadingMode::Texture:
+        {
+        Normal face_normal;
+        if(ip_face_normal != nullptr)
+          face_normal = *ip_face_normal;
+        else
+          {
+          WorldPoint const& world_v1 = i_world_point(0);
+          face_normal = (i_world_point(1) - world_v1) ^ (i_world_point(2) - world_v1);
+          face_normal.Normalise();
+          }
+        auto const intensity = _GetIntensityFromNormal(face_normal);
+        if(i_shading_mode == ShadingMode::Flat)
+          _SubmitFlatTriangle(i_pt1, i_pt2, i_pt3, _GetGrayColorFromIntensity(static_cast<int>(intensity * 255)));
+        else
+          _SubmitTexturedTriangle(i_pt1, i_pt2, i_pt3, i_texture_point(0), i_texture_point(1), i_texture_point(2), intensity);
+        break;
+        }
+      case ShadingMode::Gouraud:
+        _SubmitGouraudTriangle(i_pt1, i_pt2, i_pt3, i_normal(0), i_normal(1), i_normal(2));
+        break;
+      case ShadingMode::Phong:
+        _SubmitPhongTriangle(i_pt1, i_pt2, i_pt3, i_normal(0), i_normal(1), i_normal(2));
+        break;
+      case ShadingMode::GouraudTexture:
+        _SubmitGouraudTriangle(i_pt1, i_pt2, i_pt3, i_texture_point(0), i_texture_point(1), i_texture_point(2),
+                               i_normal(0), i_normal(1), i_normal(2));
+        break;
+      case ShadingMode::PhongTexture:
+        _SubmitPhongTriangle(i_pt1, i_pt2, i_pt3, i_texture_point(0), i_texture_point(1), i_texture_point(2),
+                             i_normal(0), i_normal(1), i_normal(2));
+        break;
+      }
+    };
+
+  if(m_depth_format != DepthFormat::Float32)
+    {
+    submit(pt1, pt2, pt3);
+    return;
+    }
+  auto const depth_point = [this](std::size_t i_v, Point const& i_pt)
+    {
+    return _DepthPoint(std::get<0>(i_pt), std::get<1>(i_pt), m_transformed_vertices[3 * i_v + 2]);
+    };
+  submit(depth_point(i_v1, pt1), depth_point(i_v2, pt2), depth_point(i_v3, pt3));
+  }
+
 //-----------------------------------------------------------------------------
 template<DimensionType NDirection, typename TPoint>
 void
@@ -1,11 +1,28 @@
 
 #pragma once
 
+#include "./DepthFormats.h"
 #include "./Image.h"
+#include "./HierarchicalZBuffer.h"
+#include "./PlanarImage.h"
+#include "./RGBA8Pixel.h"
+#include "./RGBPixel.h"
+#include "./../Geometry/BoundingVolumeHierarchy.h"
 #include "./../Geometry/Vector.h"
 #include "./../Geometry/Point.h"
+#include "./../Geometry/Matrix.h"
+#include "./../Geometry/Mesh.h"
+#include "./../Geometry/IndexedMesh.h"
+#include "./../Geometry/MappedMesh.h"
+#include "./../Geometry/Meshlet.h"
 
-#include <itkRGBPixel.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <tuple>
+#include <utility>
+#include <variant>
+#include <vector>
 
 
 namespace Graphics {
@@ -19,22 +36,105 @@ class Canvas
   public:
     using Self = Canvas;
     
-    using Color = itk::RGBPixel<unsigned char>;
+    using Color = Graphics::RGBPixel<unsigned char>; // what shading computes, whatever the pixel format
     using Image = Graphics::Image<Color>;
-    using Buffer = Graphics::Image<int>;
+    using PackedImage = Graphics::Image<Graphics::RGBA8Pixel>;
+    using PlanarImage = Graphics::PlanarImage<Color::ComponentType>;
+    using Buffer = Graphics::Image<int>; // Int32 depth
 
     using Point = Geometry::Point<int, 3>;
     using Vector = Geometry::Vector<int, 3>;
     using Normal = Geometry::Vector<float, 3>;
     using TexturePoint = Geometry::Point<float, 3>;
+    using WorldPoint = Geometry::Point<float, 3>;
+    using Mesh = Geometry::Mesh<WorldPoint, TexturePoint, Normal>;
+    using CompactMesh = Geometry::Mesh<WorldPoint, TexturePoint, Normal, std::uint16_t>; // below 64k vertices
+    using MappedMesh = Geometry::MappedMesh<WorldPoint, TexturePoint, Normal>;
+    using IndexedMesh = Geometry::IndexedMesh<WorldPoint, TexturePoint, Normal>;
+    using Meshlets = std::vector<Geometry::Meshlet>; // from Geometry::BuildMeshlets
+    using MeshHierarchy = Geometry::BoundingVolumeHierarchy; // built over the faces of the drawn mesh
+    using Transform = Geometry::Matrix<float, 4, 4>; // world -> screen, including viewport
 
-    Canvas(DimensionType i_w, DimensionType i_h);
+    // Storage of the color buffer, fixed at construction
+    enum class PixelFormat
+      {
+      RGB8,       // Image: 3 bytes per pixel, interleaved
+      RGBA8,      // PackedImage: one 32-bit store per pixel, alpha is opaque
+      PlanarRGB8  // PlanarImage: one plane per component
+      };
 
+    // Encoding of the depth buffer, fixed at construction; see DepthFormats.h
+    enum class DepthFormat
+      {
+      Int32,   // screen z as is
+      UInt16,  // screen z clamped to [0, 65535], half the memory
+      Float32  // reversed-Z float; meshes keep the sub-unit z of the vertex transform
+      };
+
+    enum class Rasterizer
+      {
+      Scanline,  // edges walking + horizontal spans
+      HalfSpace  // edge functions over 8x8 pixel blocks (SIMD coverage masks)
+      };
+
+    // Color getter used by DrawMesh, the same as DrawFilledTriangle* functions provide
+    enum class ShadingMode
+      {
+      Flat,           // one gray intensity per face
+      Texture,        // texture modulated by face intensity
+      Gouraud,        // intensity interpolated from vertex normals
+      Phong,          // normals interpolated, intensity per pixel
+      GouraudTexture, // texture modulated by interpolated intensity
+      PhongTexture    // texture modulated by per pixel intensity
+      };
+
+    struct CullingStatistics
+      {
+      std::size_t m_triangles_culled; // triangles rejected before rasterization (once per bin in binned mode)
+      std::size_t m_tiles_culled;     // 8x8 tiles of not culled triangles skipped during rasterization
+      std::size_t m_meshlets_culled;  // back facing or off screen clusters of DrawMesh
+      std::size_t m_faces_culled;     // faces of DrawMesh outside the view frustum, by hierarchy query
+      };
+
+    Canvas(DimensionType i_w, DimensionType i_h, PixelFormat i_pixel_format = PixelFormat::RGB8,
+           DepthFormat i_depth_format = DepthFormat::Int32);
+
+    PixelFormat GetPixelFormat() const;
+    DepthFormat GetDepthFormat() const;
+    // Color buffer as RGB8, after a flush. Other pixel formats are converted into a new image when
+    // something was drawn since the previous call, copies or flips of the previous image are left as they are.
     Image& GetImage();
-    Image const& GetImage() const;
+    // Color buffer itself, after a flush. nullptr unless it is the pixel format of the canvas
+    PackedImage* GetPackedImage();
+    PlanarImage* GetPlanarImage();
     void SetTextureImage(Image&& i_img);
     void SetLightDirection(Normal const& i_light_direction);
 
+    // Binned mode: filled triangles and lines are only set up on Draw* calls, then sorted into
+    // i_tile_size x i_tile_size screen tiles and rasterized tile by tile in parallel on Flush().
+    // Every tile is owned by a single worker and keeps submission order, so the result is the
+    // same as without binning.
+    // i_tile_size is rounded up to a multiple of 8, so hierarchical Z tiles are never shared.
+    // i_threads_count == 0 means "use all hardware threads".
+    void SetBinning(bool i_enabled, DimensionType i_tile_size = 64, DimensionType i_threads_count = 0);
+    void Flush();
+
+    // Deferred shading: filled triangles and lines are recorded and drawn on Flush() in two passes.
+    // 1st pass writes depth only, 2nd one shades only fragments equal to the final depth,
+    // so color getters run once per visible pixel instead of once per passed depth test.
+    // Can be combined with binning, then both passes run per tile.
+    void SetDeferredShading(bool i_enabled);
+
+    // Rasterizer used by all DrawFilledTriangle* entry points
+    void SetRasterizer(Rasterizer i_rasterizer);
+
+    // Hierarchical Z: min/max depth of every 8x8 tile is kept up to date on every depth write.
+    // Triangles, or their tiles, lying completely behind the tile minimum are rejected
+    // before any pixel is visited. Doesn't change the result, only skips hidden work.
+    void SetHierarchicalZ(bool i_enabled);
+    CullingStatistics GetCullingStatistics() const;
+    void ResetCullingStatistics();
+
     void DrawLine(Point i_pt1, Point i_pt2, Color const& i_color);
     void DrawTriangle(Point const& i_pt1, Point const& i_pt2, Point const& i_pt3, Color const& i_color);
     void DrawFilledTriangle(Point const& i_pt1, Point const& i_pt2, Point const& i_pt3, Color const& i_color);
@@ -51,28 +151,222 @@ class Canvas
                                  TexturePoint const& i_tx1, TexturePoint const& i_tx2, TexturePoint const& i_tx3,
                                  Normal const& i_n1, Normal const& i_n2, Normal const& i_n3);
 
+    // Batched draw: every vertex is transformed once, back faces (clockwise on the screen) are culled,
+    // then faces are rasterized by index. Flat intensity is taken from the light direction.
+    void DrawMesh(Mesh const& i_mesh, Transform const& i_transform, ShadingMode i_shading_mode);
+    void DrawMesh(CompactMesh const& i_mesh, Transform const& i_transform, ShadingMode i_shading_mode);
+    void DrawMesh(MappedMesh const& i_mesh, Transform const& i_transform, ShadingMode i_shading_mode);
+    void DrawMesh(IndexedMesh const& i_mesh, Transform const& i_transform, ShadingMode i_shading_mode);
+    // Clustered draw: whole meshlets facing away from the camera or off the image are skipped
+    void DrawMesh(Mesh const& i_mesh, Meshlets const& i_meshlets, Transform const& i_transform, ShadingMode i_shading_mode);
+    void DrawMesh(CompactMesh const& i_mesh, Meshlets const& i_meshlets, Transform const& i_transform, ShadingMode i_shading_mode);
+    // Hierarchy draw: only faces with bounding boxes in the view frustum are drawn, in mesh order,
+    // and only their vertices are transformed
+    void DrawMesh(Mesh const& i_mesh, MeshHierarchy const& i_hierarchy, Transform const& i_transform, ShadingMode i_shading_mode);
+    void DrawMesh(CompactMesh const& i_mesh, MeshHierarchy const& i_hierarchy, Transform const& i_transform, ShadingMode i_shading_mode);
+    // Out-of-core draw: faces are taken i_chunk_faces_count at a time, only the vertices they use are
+    // gathered and transformed, and the chunk is flushed before the next one, so memory stays bounded
+    // by the chunk whatever the mesh size (the mapped file itself is paged by the OS). An obj is
+    // streamed by converting it first with Geometry::WriteMeshCacheFromObj(), see its disk cost there
+    void DrawMeshStreamed(MappedMesh const& i_mesh, Transform const& i_transform, ShadingMode i_shading_mode,
+                          std::size_t i_chunk_faces_count = 1 << 16);
+
   protected:
-    bool _Set(int i_x, int i_y, int i_z, Color const& i_color);
-    bool _Set(Point const& i_pt, Color const& i_color);
+    using _HierarchicalZ = HierarchicalZBuffer<Buffer::PixelType>;
+
+    // Half-open screen rectangle [x0, x1) x [y0, y1) pixels may be written to
+    struct _ClipRect
+      {
+      int m_x0;
+      int m_y0;
+      int m_x1;
+      int m_y1;
+      };
+
+    enum class _Pass
+      {
+      Color,     // depth test and shading at once
+      DepthOnly, // deferred shading, 1st pass
+      Shade      // deferred shading, 2nd pass: only fragments with final depth
+      };
+
+    // Filled triangle or line postponed until Flush() by binning or deferred shading
+    struct _RecordedTriangle
+      {
+      _ClipRect m_bounds;
+      std::function<void(_ClipRect const&, _Pass)> m_draw;
+      };
+
+    _ClipRect _GetCanvasRect();
+    template<typename TPoint>
+    static _ClipRect _GetTriangleBounds(TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3, _ClipRect const& i_rect);
+
+    // Color buffer rows of every pixel format: rasterizers are instantiated per row type,
+    // so stores are resolved at compile time. Read converts a row back for GetImage.
+    // Get skips the copy on write check, the target is made unique before drawing.
+    // SetBlock stores the pixels of i_mask among the 8 from i_x, a half-space block row.
+    struct _RGB8Row
+      {
+      using ImageType = Image;
+      Color* mp_pixels;
+      static ImageType Create(DimensionType i_w, DimensionType i_h, Color const& i_color);
+      static _RGB8Row Get(ImageType& io_image, int i_y);
+      void Set(int i_x, Color const& i_color) const;
+      void SetBlock(int i_x, Color const* ip_colors, unsigned int i_mask) const;
+      };
+    struct _RGBA8Row
+      {
+      using ImageType = PackedImage;
+      PackedImage::PixelType* mp_pixels;
+      static ImageType Create(DimensionType i_w, DimensionType i_h, Color const& i_color);
+      static _RGBA8Row Get(ImageType& io_image, int i_y);
+      static void Read(ImageType const& i_image, int i_y, Color* op_colors);
+      void Set(int i_x, Color const& i_color) const;
+      void SetBlock(int i_x, Color const* ip_colors, unsigned int i_mask) const;
+      };
+    struct _PlanarRGB8Row
+      {
+      using ImageType = PlanarImage;
+      Color::ComponentType* mp_planes[PlanarImage::PlanesCount];
+      static ImageType Create(DimensionType i_w, DimensionType i_h, Color const& i_color);
+      static _PlanarRGB8Row Get(ImageType& io_image, int i_y);
+      static void Read(ImageType const& i_image, int i_y, Color* op_colors);
+      void Set(int i_x, Color const& i_color) const;
+      void SetBlock(int i_x, Color const* ip_colors, unsigned int i_mask) const;
+      };
+
+    // Color buffer, depth buffer and hierarchical Z of one pixel format and depth format.
+    // The canvas holds the target of its own formats only. Everything touching pixels is
+    // instantiated per target type, the formats are looked at once per triangle or pixel.
+    template<typename TColorRow, typename TDepth>
+    struct _Target
+      {
+      using ColorRow = TColorRow;
+      using Depth = TDepth;
+
+      _Target(DimensionType i_w, DimensionType i_h); // black, every depth cleared
+
+      typename TColorRow::ImageType m_color;
+      Graphics::Image<typename TDepth::ValueType> m_depth;
+      HierarchicalZBuffer<typename TDepth::ValueType> m_hierarchical_z; // built by SetHierarchicalZ
+      };
+    using _AnyTarget = std::variant<_Target<_RGB8Row, Int32Depth>, _Target<_RGB8Row, UInt16Depth>,
+                                    _Target<_RGB8Row, Float32ReversedDepth>,
+                                    _Target<_RGBA8Row, Int32Depth>, _Target<_RGBA8Row, UInt16Depth>,
+                                    _Target<_RGBA8Row, Float32ReversedDepth>,
+                                    _Target<_PlanarRGB8Row, Int32Depth>, _Target<_PlanarRGB8Row, UInt16Depth>,
+                                    _Target<_PlanarRGB8Row, Float32ReversedDepth>>;
+
+    static _AnyTarget _CreateTarget(DimensionType i_w, DimensionType i_h, PixelFormat i_pixel_format, DepthFormat i_depth_format);
+    template<typename TColorRow>
+    static _AnyTarget _CreateTarget(DimensionType i_w, DimensionType i_h, DepthFormat i_depth_format);
+    // Calls i_visitor with the target of the canvas formats
+    template<typename F>
+    void _VisitTarget(F i_visitor);
+    // Copies shared color and depth buffers once, so rasterizers write rows without checking
+    void _MakeTargetUnique();
+
+    void _DrawLine(Point i_pt1, Point i_pt2, Color const& i_color, _ClipRect const& i_rect, _Pass i_pass);
+    bool _Set(int i_x, int i_y, int i_z, Color const& i_color, _ClipRect const& i_rect, _Pass i_pass);
 
     Color _GetColorFromTexture(int i_x, int i_y, float i_intensity);
     Normal::ValueType _GetIntensityFromNormal(Normal const& i_normal);
     Color _GetGrayColorFromIntensity(int i_intensity);
 
+    template<typename TTarget, typename TPoint, typename F>
+    void _DrawHLine(TTarget& io_target, TPoint const& i_pt1, TPoint const& i_pt2, F i_color_getter, _ClipRect const& i_rect,
+                    _Pass i_pass);
+
+    // Screen point with the float z of the vertex transform, submitted by meshes for float depth
+    using _DepthPoint = std::tuple<Point::ValueType, Point::ValueType, float>;
+    template<typename TPoint>
+    using _ZType = typename std::tuple_element<2, TPoint>::type;
+
+    // Filled triangles of Point or _DepthPoint: Draw* functions with the z type of the point
+    template<typename TPoint>
+    void _SubmitFlatTriangle(TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3, Color const& i_color);
+    template<typename TPoint>
+    void _SubmitTexturedTriangle(TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3,
+                                 TexturePoint const& i_tx1, TexturePoint const& i_tx2, TexturePoint const& i_tx3, float i_intensity);
+    template<typename TPoint>
+    void _SubmitGouraudTriangle(TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3,
+                                Normal const& i_n1, Normal const& i_n2, Normal const& i_n3);
+    template<typename TPoint>
+    void _SubmitPhongTriangle(TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3,
+                              Normal const& i_n1, Normal const& i_n2, Normal const& i_n3);
+    template<typename TPoint>
+    void _SubmitGouraudTriangle(TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3,
+                                TexturePoint const& i_tx1, TexturePoint const& i_tx2, TexturePoint const& i_tx3,
+                                Normal const& i_n1, Normal const& i_n2, Normal const& i_n3);
+    template<typename TPoint>
+    void _SubmitPhongTriangle(TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3,
+                              TexturePoint const& i_tx1, TexturePoint const& i_tx2, TexturePoint const& i_tx3,
+                              Normal const& i_n1, Normal const& i_n2, Normal const& i_n3);
+
     template<typename TPoint, typename F>
-    void _DrawHLine(TPoint const& i_pt1, TPoint const& i_pt2, F i_color_getter);
+    void _SubmitFilledTriangle(TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3, F i_color_getter);
 
     template<typename TPoint, typename F>
-    void _DrawFilledTriangle(TPoint const* ip_pt1, TPoint const* ip_pt2, TPoint const* ip_pt3, F i_color_getter);
+    void _DrawFilledTriangle(TPoint const* ip_pt1, TPoint const* ip_pt2, TPoint const* ip_pt3, F i_color_getter,
+                             _ClipRect const& i_rect, _Pass i_pass);
+    template<typename TTarget, typename TPoint>
+    bool _IsOccluded(TTarget& io_target, TPoint const& i_pt1, TPoint const& i_pt2, TPoint const& i_pt3, _ClipRect const& i_rect,
+                     _Pass i_pass);
+    template<typename TTarget, typename TPoint, typename F>
+    void _DrawFilledTriangleScanline(TTarget& io_target, TPoint const* ip_pt1, TPoint const* ip_pt2, TPoint const* ip_pt3,
+                                     F i_color_getter, _ClipRect const& i_rect, _Pass i_pass);
+    template<typename TTarget, typename TPoint, typename F>
+    void _DrawFilledTriangleHalfSpace(TTarget& io_target, TPoint const* ip_pt1, TPoint const* ip_pt2, TPoint const* ip_pt3,
+                                      F i_color_getter, _ClipRect const& i_rect, _Pass i_pass);
+
+    template<typename TMesh>
+    void _DrawMesh(TMesh const& i_mesh, Meshlets const* ip_meshlets, MeshHierarchy const* ip_hierarchy,
+                   Transform const& i_transform, ShadingMode i_shading_mode);
+    void _TransformMeshVertices(float const* ip_positions, std::size_t i_stride, std::size_t i_count, Transform const& i_transform);
+    template<typename TMesh, typename FFaceIndex>
+    void _GatherFaceVertices(TMesh const& i_mesh, std::size_t i_faces_count, FFaceIndex i_face_index);
+    template<typename FWorldPoint, typename FTexturePoint, typename FNormal>
+    void _DrawMeshTriangle(std::size_t i_v1, std::size_t i_v2, std::size_t i_v3, ShadingMode i_shading_mode,
+                           FWorldPoint i_world_point, FTexturePoint i_texture_point, FNormal i_normal,
+                           Normal const* ip_face_normal = nullptr);
 
     template<DimensionType NDirection, typename TPoint>
     static void _Sort3PointsInDirection(TPoint const*& ip_pt1, TPoint const*& ip_pt2, TPoint const*& ip_pt3);
 
   private:
-    Image m_image;
+    DimensionType m_width;
+    DimensionType m_height;
+    PixelFormat m_pixel_format;
+    DepthFormat m_depth_format;
+    _AnyTarget m_target;
+    Image m_converted_image; // GetImage of other pixel formats than RGB8
+    bool m_is_converted_image_outdated;
     Image m_texture_image;
-    Buffer m_z_buffer;
     Normal m_light_direction;
+    Rasterizer m_rasterizer;
+
+    bool m_binning_enabled;
+    DimensionType m_tile_size;
+    DimensionType m_threads_count;
+    bool m_deferred_shading_enabled;
+    std::vector<_RecordedTriangle> m_recorded_triangles;
+
+    bool m_hierarchical_z_enabled;
+    std::atomic<std::size_t> m_triangles_culled;
+    std::atomic<std::size_t> m_tiles_culled;
+    std::size_t m_meshlets_culled;
+    std::size_t m_faces_culled;
+
+    // Post-transform vertex buffers of DrawMesh, kept to reuse their memory
+    std::vector<float> m_transformed_vertices; // packed x, y, z after divide
+    std::vector<float> m_transformed_w;
+    std::vector<Point> m_screen_vertices;
+    std::vector<unsigned char> m_screen_vertices_valid; // in front of the camera (w > 0)
+    std::vector<std::size_t> m_visible_faces;           // hierarchy query result, in mesh order
+    // Vertices used by a subset of faces: chunks of DrawMeshStreamed, hierarchy query results
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> m_chunk_corners; // mesh vertex, corner
+    std::vector<std::uint32_t> m_chunk_indices;                           // chunk vertex of every corner
+    std::vector<WorldPoint> m_chunk_vertices;
   };
 
 
@@ -0,0 +1,183 @@
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DEPTH_FORMATS_SSE2
+#include <emmintrin.h>
+#endif
+
+
+namespace Graphics {
+
+
+// Depth buffer encodings of rasterizer z (greater is closer). ZType is the z the
+// rasterizer interpolates for the format. Encode() never decreases, so depth tests
+// and hierarchical Z tiles work on encoded values as is.
+// Cleared value is the lowest one: every fragment passes against a cleared pixel.
+// TestBlockRow() tests 8 neighbouring fragments at once: bit i of the result is set
+// when i_z[i] passes against ip_depths[i] (equals it for i_is_equal, as the
+// deferred shading pass needs).
+
+///////////////////////////////////////////////////////////////////////////////
+// Int32Depth // struct declaration //
+///////////////////////////////////////////////////////////////////////////////
+// z as is
+struct Int32Depth
+  {
+  using ValueType = int;
+  using ZType = int;
+  static constexpr ValueType Cleared = std::numeric_limits<ValueType>::min();
+
+  static ValueType Encode(int i_z);
+  static unsigned int TestBlockRow(ValueType const* ip_depths, int const (&i_z)[8], bool i_is_equal);
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// UInt16Depth // struct declaration //
+///////////////////////////////////////////////////////////////////////////////
+// z clamped to [0, 65535], half the memory and bandwidth of 32 bits; the viewport
+// depth range is expected to fit it, fragments out of it tie on the boundaries
+struct UInt16Depth
+  {
+  using ValueType = std::uint16_t;
+  using ZType = int;
+  static constexpr ValueType Cleared = 0;
+
+  static ValueType Encode(int i_z);
+  static unsigned int TestBlockRow(ValueType const* ip_depths, int const (&i_z)[8], bool i_is_equal);
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Float32ReversedDepth // struct declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Reversed-Z: float z, kept from the vertex transform instead of truncated to int,
+// mapped from the [0, 65535] range of UInt16Depth to [0, 1], the near end to 1 and
+// the cleared value to 0. After the perspective divide far depths crowd together,
+// and floats are densest near 0, so precision stays even over the whole range.
+struct Float32ReversedDepth
+  {
+  using ValueType = float;
+  using ZType = float;
+  static constexpr ValueType Cleared = 0.f;
+  static constexpr float Scale = 1.f / 65535.f;
+
+  static ValueType Encode(float i_z);
+  static unsigned int TestBlockRow(ValueType const* ip_depths, float const (&i_z)[8], bool i_is_equal);
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Int32Depth // struct definition //
+///////////////////////////////////////////////////////////////////////////////
+inline Int32Depth::ValueType
+Int32Depth::Encode(int i_z)
+  {
+  return i_z;
+  }
+
+//-----------------------------------------------------------------------------
+inline unsigned int
+Int32Depth::TestBlockRow(ValueType const* ip_depths, int const (&i_z)[8], bool i_is_equal)
+  {
+#if defined(DEPTH_FORMATS_SSE2)
+  unsigned int mask = 0;
+  for(int half = 0; half < 2; ++half)
+    {
+    __m128i const z = _mm_loadu_si128(reinterpret_cast<__m128i const*>(i_z + 4 * half));
+    __m128i const depths = _mm_loadu_si128(reinterpret_cast<__m128i const*>(ip_depths + 4 * half));
+    __m128i const passed = i_is_equal ? _mm_cmpeq_epi32(z, depths)
+                                      : _mm_xor_si128(_mm_cmplt_epi32(z, depths), _mm_set1_epi32(-1));
+    mask |= static_cast<unsigned int>(_mm_movemask_ps(_mm_castsi128_ps(passed))) << (4 * half);
+    }
+  return mask;
+#else
+  unsigned int mask = 0;
+  for(int i = 0; i < 8; ++i)
+    if(i_is_equal ? i_z[i] == ip_depths[i] : i_z[i] >= ip_depths[i])
+      mask |= 1u << i;
+  return mask;
+#endif
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// UInt16Depth // struct definition //
+///////////////////////////////////////////////////////////////////////////////
+inline UInt16Depth::ValueType
+UInt16Depth::Encode(int i_z)
+  {
+  return static_cast<ValueType>(std::min(std::max(i_z, 0), static_cast<int>(std::numeric_limits<ValueType>::max())));
+  }
+
+//-----------------------------------------------------------------------------
+inline unsigned int
+UInt16Depth::TestBlockRow(ValueType const* ip_depths, int const (&i_z)[8], bool i_is_equal)
+  {
+#if defined(DEPTH_FORMATS_SSE2)
+  // SSE2 has signed 16-bit compares only: both sides are biased by -32768, for z the signed
+  // saturating pack does the clamping of Encode() at the same time
+  __m128i const bias = _mm_set1_epi32(32768);
+  __m128i const z = _mm_packs_epi32(_mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(i_z)), bias),
+                                    _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(i_z + 4)), bias));
+  __m128i const depths = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<__m128i const*>(ip_depths)), _mm_set1_epi16(-32768));
+  __m128i const passed = i_is_equal ? _mm_cmpeq_epi16(z, depths)
+                                    : _mm_xor_si128(_mm_cmplt_epi16(z, depths), _mm_set1_epi16(-1));
+  return static_cast<unsigned int>(_mm_movemask_epi8(_mm_packs_epi16(passed, _mm_setzero_si128())));
+#else
+  unsigned int mask = 0;
+  for(int i = 0; i < 8; ++i)
+    {
+    ValueType const z = Encode(i_z[i]);
+    if(i_is_equal ? z == ip_depths[i] : z >= ip_depths[i])
+      mask |= 1u << i;
+    }
+  return mask;
+#endif
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Float32ReversedDepth // struct definition //
+///////////////////////////////////////////////////////////////////////////////
+inline Float32ReversedDepth::ValueType
+Float32ReversedDepth::Encode(float i_z)
+  {
+  return std::min(std::max(i_z * Scale, 0.f), 1.f);
+  }
+
+//-----------------------------------------------------------------------------
+inline unsigned int
+Float32ReversedDepth::TestBlockRow(ValueType const* ip_depths, float const (&i_z)[8], bool i_is_equal)
+  {
+#if defined(DEPTH_FORMATS_SSE2)
+  __m128 const scale = _mm_set1_ps(Scale);
+  __m128 const one = _mm_set1_ps(1.f);
+  unsigned int mask = 0;
+  for(int half = 0; half < 2; ++half)
+    {
+    __m128 const z = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(i_z + 4 * half), scale), _mm_setzero_ps()), one);
+    __m128 const depths = _mm_loadu_ps(ip_depths + 4 * half);
+    __m128 const passed = i_is_equal ? _mm_cmpeq_ps(z, depths) : _mm_cmpge_ps(z, depths);
+    mask |= static_cast<unsigned int>(_mm_movemask_ps(passed)) << (4 * half);
+    }
+  return mask;
+#else
+  unsigned int mask = 0;
+  for(int i = 0; i < 8; ++i)
+    {
+    ValueType const z = Encode(i_z[i]);
+    if(i_is_equal ? z == ip_depths[i] : z >= ip_depths[i])
+      mask |= 1u << i;
+    }
+  return mask;
+#endif
+  }
+
+
+} // namespace Graphics
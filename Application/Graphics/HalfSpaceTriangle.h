@@ -0,0 +1,219 @@
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define HALF_SPACE_TRIANGLE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HALF_SPACE_TRIANGLE_SSE2
+#endif
+
+
+namespace Graphics {
+
+
+///////////////////////////////////////////////////////////////////////////////
+// HalfSpaceTriangle // struct declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Triangle as intersection of 3 half-planes E(x, y) = a * x + b * y + c >= 0.
+// Pixels are sampled at integer coordinates and edges are inclusive, the same
+// way as the scanline rasterizer closes its spans.
+// Coverage is evaluated for 8x8 pixel blocks: bit (row * 8 + column) of the mask.
+struct HalfSpaceTriangle
+  {
+  static constexpr int BlockSize = 8;
+
+  // Coordinates outside [-MaxCoordinate, MaxCoordinate] could overflow int edge values
+  static constexpr int MaxCoordinate = 1 << 14;
+
+  struct Edge
+    {
+    int m_a;
+    int m_b;
+    int m_c;
+
+    int Evaluate(int i_x, int i_y) const;
+    };
+
+  // Returns false for degenerate (zero area) triangles or too large coordinates.
+  // Vertices are reordered to counter-clockwise, IsSwapped tells whether 2nd and 3rd were exchanged.
+  bool Setup(int i_x0, int i_y0, int i_x1, int i_y1, int i_x2, int i_y2);
+
+  bool IsSwapped() const;
+  int GetDoubleArea() const;
+  Edge const& GetEdge(int i_idx) const; // 0 - edge 12 (weight of v0), 1 - edge 20, 2 - edge 01
+
+  std::uint64_t GetBlockCoverage(int i_block_x, int i_block_y) const;
+
+  private:
+    std::uint64_t _GetPartialBlockCoverage(int i_block_x, int i_block_y) const;
+
+    Edge m_edges[3];
+    int m_double_area;
+    bool m_swapped;
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// HalfSpaceTriangle // struct definition //
+///////////////////////////////////////////////////////////////////////////////
+inline int
+HalfSpaceTriangle::Edge::Evaluate(int i_x, int i_y) const
+  {
+  return m_a * i_x + m_b * i_y + m_c;
+  }
+
+//-----------------------------------------------------------------------------
+inline bool
+HalfSpaceTriangle::Setup(int i_x0, int i_y0, int i_x1, int i_y1, int i_x2, int i_y2)
+  {
+  for(int coord : {i_x0, i_y0, i_x1, i_y1, i_x2, i_y2})
+    if(coord < -MaxCoordinate || coord > MaxCoordinate)
+      return false;
+
+  m_double_area = (i_x1 - i_x0) * (i_y2 - i_y0) - (i_y1 - i_y0) * (i_x2 - i_x0);
+  if(m_double_area == 0)
+    return false;
+
+  m_swapped = m_double_area < 0;
+  if(m_swapped)
+    {
+    std::swap(i_x1, i_x2);
+    std::swap(i_y1, i_y2);
+    m_double_area = -m_double_area;
+    }
+
+  // Edge from i to j: E(x, y) = (xj - xi) * (y - yi) - (yj - yi) * (x - xi)
+  auto setup_edge = [](Edge& o_edge, int i_xi, int i_yi, int i_xj, int i_yj)
+    {
+    o_edge.m_a = i_yi - i_yj;
+    o_edge.m_b = i_xj - i_xi;
+    o_edge.m_c = i_yj * i_xi - i_xj * i_yi;
+    };
+  setup_edge(m_edges[0], i_x1, i_y1, i_x2, i_y2);
+  setup_edge(m_edges[1], i_x2, i_y2, i_x0, i_y0);
+  setup_edge(m_edges[2], i_x0, i_y0, i_x1, i_y1);
+  return true;
+  }
+
+//-----------------------------------------------------------------------------
+inline bool
+HalfSpaceTriangle::IsSwapped() const
+  {
+  return m_swapped;
+  }
+
+//-----------------------------------------------------------------------------
+inline int
+HalfSpaceTriangle::GetDoubleArea() const
+  {
+  return m_double_area;
+  }
+
+//-----------------------------------------------------------------------------
+inline HalfSpaceTriangle::Edge const&
+HalfSpaceTriangle::GetEdge(int i_idx) const
+  {
+  return m_edges[i_idx];
+  }
+
+//-----------------------------------------------------------------------------
+inline std::uint64_t
+HalfSpaceTriangle::GetBlockCoverage(int i_block_x, int i_block_y) const
+  {
+  int const last = BlockSize - 1;
+  bool is_inside = true;
+  for(auto const& edge : m_edges)
+    {
+    // Edge function is linear, so its extremes over the block are in the corners
+    int const e00 = edge.Evaluate(i_block_x, i_block_y);
+    int const e10 = e00 + edge.m_a * last;
+    int const e01 = e00 + edge.m_b * last;
+    int const e11 = e10 + edge.m_b * last;
+    if(std::max(std::max(e00, e10), std::max(e01, e11)) < 0)
+      return 0; // Trivial reject: whole block is outside of this edge
+    if(std::min(std::min(e00, e10), std::min(e01, e11)) < 0)
+      is_inside = false;
+    }
+  if(is_inside)
+    return ~std::uint64_t(0); // Trivial accept
+
+  return _GetPartialBlockCoverage(i_block_x, i_block_y);
+  }
+
+//-----------------------------------------------------------------------------
+inline std::uint64_t
+HalfSpaceTriangle::_GetPartialBlockCoverage(int i_block_x, int i_block_y) const
+  {
+  std::uint64_t mask = 0;
+
+#if defined(HALF_SPACE_TRIANGLE_AVX2)
+  __m256i const lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  __m256i const minus_one = _mm256_set1_epi32(-1);
+  __m256i rows[3];
+  __m256i steps_y[3];
+  for(int i = 0; i < 3; ++i)
+    {
+    rows[i] = _mm256_add_epi32(_mm256_set1_epi32(m_edges[i].Evaluate(i_block_x, i_block_y)),
+                               _mm256_mullo_epi32(lanes, _mm256_set1_epi32(m_edges[i].m_a)));
+    steps_y[i] = _mm256_set1_epi32(m_edges[i].m_b);
+    }
+  for(int row = 0; row < BlockSize; ++row)
+    {
+    __m256i inside = _mm256_and_si256(_mm256_cmpgt_epi32(rows[0], minus_one),
+                     _mm256_and_si256(_mm256_cmpgt_epi32(rows[1], minus_one),
+                                      _mm256_cmpgt_epi32(rows[2], minus_one)));
+    mask |= std::uint64_t(_mm256_movemask_ps(_mm256_castsi256_ps(inside))) << (row * BlockSize);
+    for(int i = 0; i < 3; ++i)
+      rows[i] = _mm256_add_epi32(rows[i], steps_y[i]);
+    }
+#elif defined(HALF_SPACE_TRIANGLE_SSE2)
+  __m128i const minus_one = _mm_set1_epi32(-1);
+  __m128i rows_lo[3];
+  __m128i rows_hi[3];
+  __m128i steps_y[3];
+  for(int i = 0; i < 3; ++i)
+    {
+    int const a = m_edges[i].m_a;
+    int const e = m_edges[i].Evaluate(i_block_x, i_block_y);
+    rows_lo[i] = _mm_setr_epi32(e, e + a, e + 2 * a, e + 3 * a);
+    rows_hi[i] = _mm_add_epi32(rows_lo[i], _mm_set1_epi32(4 * a));
+    steps_y[i] = _mm_set1_epi32(m_edges[i].m_b);
+    }
+  for(int row = 0; row < BlockSize; ++row)
+    {
+    __m128i inside_lo = _mm_and_si128(_mm_cmpgt_epi32(rows_lo[0], minus_one),
+                        _mm_and_si128(_mm_cmpgt_epi32(rows_lo[1], minus_one),
+                                      _mm_cmpgt_epi32(rows_lo[2], minus_one)));
+    __m128i inside_hi = _mm_and_si128(_mm_cmpgt_epi32(rows_hi[0], minus_one),
+                        _mm_and_si128(_mm_cmpgt_epi32(rows_hi[1], minus_one),
+                                      _mm_cmpgt_epi32(rows_hi[2], minus_one)));
+    int const row_mask = _mm_movemask_ps(_mm_castsi128_ps(inside_lo))
+                       | (_mm_movemask_ps(_mm_castsi128_ps(inside_hi)) << 4);
+    mask |= std::uint64_t(row_mask) << (row * BlockSize);
+    for(int i = 0; i < 3; ++i)
+      {
+      rows_lo[i] = _mm_add_epi32(rows_lo[i], steps_y[i]);
+      rows_hi[i] = _mm_add_epi32(rows_hi[i], steps_y[i]);
+      }
+    }
+#else
+  for(int row = 0; row < BlockSize; ++row)
+    for(int column = 0; column < BlockSize; ++column)
+      {
+      int const x = i_block_x + column;
+      int const y = i_block_y + row;
+      if(m_edges[0].Evaluate(x, y) >= 0 && m_edges[1].Evaluate(x, y) >= 0 && m_edges[2].Evaluate(x, y) >= 0)
+        mask |= std::uint64_t(1) << (row * BlockSize + column);
+      }
+#endif
+
+  return mask;
+  }
+
+
+} // namespace Graphics
@@ -0,0 +1,167 @@
+
+#pragma once
+
+#include "./Image.h"
+
+#include <algorithm>
+#include <vector>
+
+
+namespace Graphics {
+
+
+///////////////////////////////////////////////////////////////////////////////
+// HierarchicalZBuffer // class declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Min/max depth of every TileSize x TileSize tile of a depth buffer.
+// Depth test passes for greater or equal values, so anything with depth below
+// the tile minimum is hidden. Maximum is kept exact on every write; minimum is
+// recomputed lazily, only after the last pixel holding it has been overwritten.
+template<typename TDepth>
+class HierarchicalZBuffer
+  {
+  public:
+    static constexpr int TileShift = 3;
+    static constexpr int TileSize = 1 << TileShift;
+    static constexpr int TileMask = TileSize - 1;
+
+    using DepthType = TDepth;
+    using DepthImage = Graphics::Image<DepthType>;
+
+    HierarchicalZBuffer();
+
+    // Rebuilds all tiles from the depth buffer
+    void Build(DepthImage const& i_depth_buffer);
+
+    int GetTilesX() const;
+    int GetTilesY() const;
+
+    // Must be called for every depth write, i_old is the overwritten value
+    void OnWrite(int i_x, int i_y, DepthType i_old, DepthType i_new);
+
+    // True if a fragment not deeper than i_z_max can't pass depth test anywhere in the tile
+    bool IsOccluded(int i_tile_x, int i_tile_y, DepthType i_z_max, DepthImage const& i_depth_buffer);
+
+  private:
+    struct _Tile
+      {
+      DepthType m_min;
+      DepthType m_max;
+      int m_min_count; // pixels equal to m_min; 0 means m_min is outdated (too low)
+      };
+
+    void _Refresh(_Tile& io_tile, int i_tile_x, int i_tile_y, DepthImage const& i_depth_buffer) const;
+
+    std::vector<_Tile> m_tiles;
+    int m_tiles_x;
+    int m_tiles_y;
+    int m_width;
+    int m_height;
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// HierarchicalZBuffer // class definition //
+///////////////////////////////////////////////////////////////////////////////
+template<typename TDepth>
+HierarchicalZBuffer<TDepth>::HierarchicalZBuffer()
+  : m_tiles()
+  , m_tiles_x(0)
+  , m_tiles_y(0)
+  , m_width(0)
+  , m_height(0)
+  {
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TDepth>
+void
+HierarchicalZBuffer<TDepth>::Build(DepthImage const& i_depth_buffer)
+  {
+  m_width = static_cast<int>(i_depth_buffer.GetWidth());
+  m_height = static_cast<int>(i_depth_buffer.GetHeight());
+  m_tiles_x = (m_width + TileMask) >> TileShift;
+  m_tiles_y = (m_height + TileMask) >> TileShift;
+  m_tiles.resize(m_tiles_x * m_tiles_y);
+  for(int tile_y = 0; tile_y < m_tiles_y; ++tile_y)
+    for(int tile_x = 0; tile_x < m_tiles_x; ++tile_x)
+      _Refresh(m_tiles[tile_y * m_tiles_x + tile_x], tile_x, tile_y, i_depth_buffer);
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TDepth>
+int
+HierarchicalZBuffer<TDepth>::GetTilesX() const
+  {
+  return m_tiles_x;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TDepth>
+int
+HierarchicalZBuffer<TDepth>::GetTilesY() const
+  {
+  return m_tiles_y;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TDepth>
+void
+HierarchicalZBuffer<TDepth>::OnWrite(int i_x, int i_y, DepthType i_old, DepthType i_new)
+  {
+  _Tile& tile = m_tiles[(i_y >> TileShift) * m_tiles_x + (i_x >> TileShift)];
+  if(i_new > tile.m_max)
+    tile.m_max = i_new;
+  if(i_old == tile.m_min && i_new != i_old)
+    --tile.m_min_count;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TDepth>
+bool
+HierarchicalZBuffer<TDepth>::IsOccluded(int i_tile_x, int i_tile_y, DepthType i_z_max, DepthImage const& i_depth_buffer)
+  {
+  _Tile& tile = m_tiles[i_tile_y * m_tiles_x + i_tile_x];
+  if(i_z_max < tile.m_min)
+    return true;
+  // Refresh can only help when the exact minimum might be above i_z_max
+  if(tile.m_min_count > 0 || i_z_max >= tile.m_max)
+    return false;
+  _Refresh(tile, i_tile_x, i_tile_y, i_depth_buffer);
+  return i_z_max < tile.m_min;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TDepth>
+void
+HierarchicalZBuffer<TDepth>::_Refresh(_Tile& io_tile, int i_tile_x, int i_tile_y, DepthImage const& i_depth_buffer) const
+  {
+  int const x0 = i_tile_x << TileShift;
+  int const y0 = i_tile_y << TileShift;
+  int const x1 = std::min(x0 + TileSize, m_width);
+  int const y1 = std::min(y0 + TileSize, m_height);
+
+  DepthType const* p_row = i_depth_buffer.GetRow(y0);
+  io_tile.m_min = io_tile.m_max = p_row[x0];
+  io_tile.m_min_count = 0;
+  for(int y = y0; y < y1; ++y)
+    {
+    p_row = i_depth_buffer.GetRow(y);
+    for(int x = x0; x < x1; ++x)
+      {
+      DepthType const value = p_row[x];
+      if(value < io_tile.m_min)
+        {
+        io_tile.m_min = value;
+        io_tile.m_min_count = 0;
+        }
+      if(value == io_tile.m_min)
+        ++io_tile.m_min_count;
+      if(value > io_tile.m_max)
+        io_tile.m_max = value;
+      }
+    }
+  }
+
+
+} // namespace Graphics
@@ -1,12 +1,33 @@
-
 #pragma once
 
 #include "./../Geometry/BaseTypedefs.h"
-
+#include "./RGBA8Pixel.h"
+#include "./RGBPixel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGE_FILL_SSE2
+#include <emmintrin.h>
+#endif
+
+// ITK is only an import/export adapter: define ASR_WITH_ITK to read and write files
+#if defined(ASR_WITH_ITK)
 #include <itkImage.h>
 #include <itkImageFileWriter.h>
 #include <itkImageFileReader.h>
-#include <itkFlipImageFilter.h>
+#include <itkRGBAPixel.h>
+#include <itkRGBPixel.h>
+#endif
 
 
 namespace Graphics {
@@ -15,15 +36,28 @@ namespace Graphics {
 ///////////////////////////////////////////////////////////////////////////////
 // Image // class declaration //
 ///////////////////////////////////////////////////////////////////////////////
+// Pixels live in one contiguous buffer aligned to Alignment bytes. Rows are
+// GetRowStride() pixels apart, the stride being the width rounded up so that
+// every row starts aligned too; the padding pixels are never read.
+// The image is a view of the buffer: a negative stride walks the rows bottom
+// up, so a vertical flip only moves the first row pointer and negates the
+// stride.
+// Copies are cheap: they share the buffer until one of them writes. Set, Fill,
+// FlipVerticallyInPlace and the non-const GetRow first give the image its own
+// buffer (copy on write), so writes never show through another copy. The check
+// reads the atomic share count: writers take a row once per span, or call
+// MakeUnique() once and then use GetUniqueRow.
 template<typename TPixel>
 class Image
   {
   public:
     static constexpr DimensionType Dimension = 2;
+    static constexpr std::size_t Alignment = 64; // cache line, widest vector register
 
     using PixelType = TPixel;
     using Self = Image<PixelType>;
-    using ItkImage = itk::Image<PixelType, Dimension>;
+
+    static_assert(std::is_trivially_copyable<PixelType>::value, "pixels are moved around as raw memory");
 
     Image();
     Image(DimensionType i_x, DimensionType i_y, bool i_initialise = true);
@@ -34,59 +68,133 @@ class Image
     Image& operator=(Image const& i_another_image);
     Image& operator=(Image&& i_another_image);
 
-    void Read(const char* i_filename);
-    void Write(const char* i_filename);
+    // Both fail when the file can't be read or written, or when built without ITK
+    bool Read(const char* i_filename);
+    bool Write(const char* i_filename) const;
 
     PixelType const& Get(DimensionType i_x, DimensionType i_y) const;
+    // Slow path, checks for a shared buffer on every pixel
     void Set(DimensionType i_x, DimensionType i_y, PixelType const& i_c);
 
-    DimensionType GetWidth();
-    DimensionType GetHeight();
+    // Raw access to the i_y row: GetWidth() pixels lying sequentially in memory,
+    // aligned to Alignment bytes. Row i_y + 1 starts GetRowStride() pixels
+    // after it, which may be negative. No bounds check.
+    // The non-const one first copies a shared buffer. Row pointers are outside
+    // the copy on write: one kept from before the image is copied still points
+    // into the buffer the copy shares, so writing through it changes both images.
+    // Take row pointers again after every copy.
+    PixelType* GetRow(DimensionType i_y);
+    PixelType const* GetRow(DimensionType i_y) const;
+    // Writable row without the copy on write check, for images already made
+    // unique with MakeUnique() and not copied since
+    PixelType* GetUniqueRow(DimensionType i_y);
+
+    DimensionType GetWidth() const;
+    DimensionType GetHeight() const;
+    std::ptrdiff_t GetRowStride() const; // in pixels
 
     void Fill(PixelType const& i_value);
 
+    // Swaps the view, no pixel is moved
     void FlipVertically();
+    // Swaps the rows in the buffer and keeps the stride, for code that needs
+    // the memory order itself
+    void FlipVerticallyInPlace();
+
+    // Copies the buffer now if it is shared. Writers running on several threads
+    // call it first: the copy on write itself is not thread safe.
+    void MakeUnique();
 
   private:
-    typename ItkImage::Pointer mp_image;
+    // Pixels in the shortest run of whole pixels that is a whole number of
+    // alignment blocks; the row stride is a multiple of it
+    static constexpr std::size_t _PixelsPerBlock = Alignment / std::gcd(Alignment, sizeof(PixelType));
+    static constexpr std::size_t _BlockSize = _PixelsPerBlock * sizeof(PixelType);
+    static constexpr std::size_t _MaxRegisterFillBlockSize = 256; // larger blocks are copied with memcpy
+
+    static std::shared_ptr<PixelType> _Allocate(std::size_t i_pixels_count);
+    void _Detach(bool i_copy_pixels);
+
+  private:
+    std::shared_ptr<PixelType> mp_pixels;
+    PixelType* mp_first_row;
+    DimensionType m_width;
+    DimensionType m_height;
+    std::ptrdiff_t m_row_stride;
   };
 
+
+#if defined(ASR_WITH_ITK)
+///////////////////////////////////////////////////////////////////////////////
+// ItkPixel // struct declaration //
+///////////////////////////////////////////////////////////////////////////////
+// ITK pixel type of the same layout
+template<typename TPixel>
+struct ItkPixel
+  {
+  using Type = TPixel;
+  };
+
+//-----------------------------------------------------------------------------
+template<typename TComponent>
+struct ItkPixel<RGBPixel<TComponent>>
+  {
+  using Type = itk::RGBPixel<TComponent>;
+  };
+
+//-----------------------------------------------------------------------------
+template<>
+struct ItkPixel<RGBA8Pixel>
+  {
+  using Type = itk::RGBAPixel<RGBA8Pixel::ComponentType>;
+  };
+#endif
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Image // class definition //
 ///////////////////////////////////////////////////////////////////////////////
 template<typename TPixel>
 Image<TPixel>::Image()
-  : mp_image()
+  : mp_pixels()
+  , mp_first_row(nullptr)
+  , m_width(0)
+  , m_height(0)
+  , m_row_stride(0)
   {
   }
 
 //-----------------------------------------------------------------------------
 template<typename TPixel>
 Image<TPixel>::Image(DimensionType i_x, DimensionType i_y, bool i_initialise)
-  : mp_image(ItkImage::New())
+  : m_width(i_x)
+  , m_height(i_y)
+  , m_row_stride(static_cast<std::ptrdiff_t>((i_x + _PixelsPerBlock - 1) / _PixelsPerBlock * _PixelsPerBlock))
   {
-  ItkImage::SizeType size;
-  size[0] = i_x;
-  size[1] = i_y;
-  ItkImage::RegionType region;
-  region.SetSize(size);
-  mp_image->SetRegions(region);
-  mp_image->Allocate(i_initialise);
+  std::size_t const pixels_count = static_cast<std::size_t>(m_row_stride) * m_height;
+  mp_pixels = _Allocate(pixels_count);
+  mp_first_row = mp_pixels.get();
+  if(i_initialise && mp_pixels)
+    std::memset(static_cast<void*>(mp_pixels.get()), 0, pixels_count * sizeof(PixelType));
   }
 
 //-----------------------------------------------------------------------------
 template<typename TPixel>
 Image<TPixel>::Image(Image const& i_another_image)
-  : mp_image(i_another_image.mp_image)
+  : mp_pixels(i_another_image.mp_pixels)
+  , mp_first_row(i_another_image.mp_first_row)
+  , m_width(i_another_image.m_width)
+  , m_height(i_another_image.m_height)
+  , m_row_stride(i_another_image.m_row_stride)
   {
   }
 
 //-----------------------------------------------------------------------------
 template<typename TPixel>
 Image<TPixel>::Image(Image&& i_another_image)
-  : mp_image(i_another_image.mp_image)
+  : Image()
   {
-  i_another_image.mp_image = nullptr;
+  *this = std::move(i_another_image);
   }
 
 //-----------------------------------------------------------------------------
@@ -97,10 +205,14 @@ Image<TPixel>::~Image()
 
 //-----------------------------------------------------------------------------
 template<typename TPixel>
-Image<TPixel>& 
+Image<TPixel>&
 Image<TPixel>::operator=(Image const& i_another_image)
   {
-  mp_image = i_another_image.mp_image;
+  mp_pixels = i_another_image.mp_pixels;
+  mp_first_row = i_another_image.mp_first_row;
+  m_width = i_another_image.m_width;
+  m_height = i_another_image.m_height;
+  m_row_stride = i_another_image.m_row_stride;
   return *this;
   }
 
@@ -109,33 +221,86 @@ template<typename TPixel>
 Image<TPixel>&
 Image<TPixel>::operator=(Image&& i_another_image)
   {
-  mp_image = i_another_image.mp_image;
-  i_another_image.mp_image = nullptr;
+  mp_pixels = std::move(i_another_image.mp_pixels);
+  mp_first_row = std::exchange(i_another_image.mp_first_row, nullptr);
+  m_width = std::exchange(i_another_image.m_width, 0);
+  m_height = std::exchange(i_another_image.m_height, 0);
+  m_row_stride = std::exchange(i_another_image.m_row_stride, 0);
   return *this;
   }
 
 //-----------------------------------------------------------------------------
 template<typename TPixel>
-void
+bool
 Image<TPixel>::Read(const char* i_filename)
   {
+#if defined(ASR_WITH_ITK)
+  using ItkImage = itk::Image<typename ItkPixel<PixelType>::Type, Dimension>;
   using ReaderType = itk::ImageFileReader<ItkImage>;
-  ReaderType::Pointer reader = ReaderType::New();
-  reader->SetFileName(i_filename);
-  reader->Update();
-  mp_image = reader->GetOutput();
+  static_assert(sizeof(typename ItkImage::PixelType) == sizeof(PixelType), "pixels are copied as raw memory");
+
+  typename ItkImage::Pointer p_image;
+  try
+    {
+    typename ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName(i_filename);
+    reader->Update();
+    p_image = reader->GetOutput();
+    }
+  catch(itk::ExceptionObject const&)
+    {
+    return false;
+    }
+
+  auto const size = p_image->GetLargestPossibleRegion().GetSize();
+  Image image(static_cast<DimensionType>(size[0]), static_cast<DimensionType>(size[1]), false);
+  for(DimensionType y = 0; y < image.m_height; ++y)
+    std::memcpy(static_cast<void*>(image.GetRow(y)), p_image->GetBufferPointer() + y * image.m_width, image.m_width * sizeof(PixelType));
+  *this = std::move(image);
+  return true;
+#else
+  (void)i_filename;
+  return false;
+#endif
   }
 
 //-----------------------------------------------------------------------------
 template<typename TPixel>
-void
-Image<TPixel>::Write(const char* i_filename)
+bool
+Image<TPixel>::Write(const char* i_filename) const
   {
+#if defined(ASR_WITH_ITK)
+  using ItkImage = itk::Image<typename ItkPixel<PixelType>::Type, Dimension>;
   using WriterType = itk::ImageFileWriter<ItkImage>;
-  WriterType::Pointer writer = WriterType::New();
-  writer->SetFileName(i_filename);
-  writer->SetInput(mp_image);
-  writer->Update();
+  static_assert(sizeof(typename ItkImage::PixelType) == sizeof(PixelType), "pixels are copied as raw memory");
+
+  typename ItkImage::SizeType size;
+  size[0] = m_width;
+  size[1] = m_height;
+  typename ItkImage::RegionType region;
+  region.SetSize(size);
+  typename ItkImage::Pointer p_image = ItkImage::New();
+  p_image->SetRegions(region);
+  p_image->Allocate(false);
+  for(DimensionType y = 0; y < m_height; ++y)
+    std::memcpy(static_cast<void*>(p_image->GetBufferPointer() + y * m_width), GetRow(y), m_width * sizeof(PixelType));
+
+  try
+    {
+    typename WriterType::Pointer writer = WriterType::New();
+    writer->SetFileName(i_filename);
+    writer->SetInput(p_image);
+    writer->Update();
+    }
+  catch(itk::ExceptionObject const&)
+    {
+    return false;
+    }
+  return true;
+#else
+  (void)i_filename;
+  return false;
+#endif
   }
 
 //-----------------------------------------------------------------------------
@@ -143,36 +308,64 @@ template<typename TPixel>
 typename Image<TPixel>::PixelType const&
 Image<TPixel>::Get(DimensionType i_x, DimensionType i_y) const
   {
-  ItkImage::IndexType index;
-  index[0] = i_x;
-  index[1] = i_y;
-  return mp_image->GetPixel(index);
+  return GetRow(i_y)[i_x];
   }
 
 //-----------------------------------------------------------------------------
 template<typename TPixel>
 void Image<TPixel>::Set(DimensionType i_x, DimensionType i_y, PixelType const& i_c)
   {
-  ItkImage::IndexType index;
-  index[0] = i_x;
-  index[1] = i_y;
-  mp_image->SetPixel(index, i_c);
+  GetRow(i_y)[i_x] = i_c;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TPixel>
+typename Image<TPixel>::PixelType*
+Image<TPixel>::GetRow(DimensionType i_y)
+  {
+  MakeUnique();
+  return const_cast<PixelType*>(const_cast<Self const*>(this)->GetRow(i_y));
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TPixel>
+typename Image<TPixel>::PixelType const*
+Image<TPixel>::GetRow(DimensionType i_y) const
+  {
+  return mp_first_row + static_cast<std::ptrdiff_t>(i_y) * m_row_stride;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TPixel>
+typename Image<TPixel>::PixelType*
+Image<TPixel>::GetUniqueRow(DimensionType i_y)
+  {
+  assert(mp_pixels.use_count() <= 1);
+  return const_cast<PixelType*>(const_cast<Self const*>(this)->GetRow(i_y));
   }
 
 //-----------------------------------------------------------------------------
 template<typename TPixel>
 DimensionType
-Image<TPixel>::GetWidth()
+Image<TPixel>::GetWidth() const
   {
-  return mp_image->GetLargestPossibleRegion().GetSize()[0];
+  return m_width;
   }
 
 //-----------------------------------------------------------------------------
 template<typename TPixel>
 DimensionType
-Image<TPixel>::GetHeight()
+Image<TPixel>::GetHeight() const
   {
-  return mp_image->GetLargestPossibleRegion().GetSize()[1];
+  return m_height;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TPixel>
+std::ptrdiff_t
+Image<TPixel>::GetRowStride() const
+  {
+  return m_row_stride;
   }
 
 //-----------------------------------------------------------------------------
@@ -180,7 +373,32 @@ template<typename TPixel>
 void
 Image<TPixel>::Fill(PixelType const& i_value)
   {
-  mp_image->FillBuffer(i_value);
+  std::size_t const size = static_cast<std::size_t>(std::abs(m_row_stride)) * m_height * sizeof(PixelType);
+  if(size == 0)
+    return;
+  if(mp_pixels.use_count() > 1)
+    _Detach(false); // every pixel is overwritten
+
+  // The first block is filled pixel by pixel and then repeated: the buffer is a
+  // whole number of blocks, all aligned
+  PixelType* p_pixels = mp_pixels.get();
+  std::fill(p_pixels, p_pixels + _PixelsPerBlock, i_value);
+  char* p_bytes = reinterpret_cast<char*>(p_pixels);
+#if defined(IMAGE_FILL_SSE2)
+  if(_BlockSize <= _MaxRegisterFillBlockSize)
+    {
+    constexpr std::size_t registers_count = std::min(_BlockSize, _MaxRegisterFillBlockSize) / sizeof(__m128i);
+    __m128i pattern[registers_count];
+    for(std::size_t i = 0; i < registers_count; ++i)
+      pattern[i] = _mm_load_si128(reinterpret_cast<__m128i const*>(p_bytes) + i);
+    for(std::size_t offset = _BlockSize; offset < size; offset += _BlockSize)
+      for(std::size_t i = 0; i < registers_count; ++i)
+        _mm_store_si128(reinterpret_cast<__m128i*>(p_bytes + offset) + i, pattern[i]);
+    return;
+    }
+#endif
+  for(std::size_t filled = _BlockSize; filled < size; filled *= 2)
+    std::memcpy(p_bytes + filled, p_bytes, std::min(filled, size - filled));
   }
 
 //-----------------------------------------------------------------------------
@@ -188,19 +406,60 @@ template<typename TPixel>
 void
 Image<TPixel>::FlipVertically()
   {
-  using FlipImageFilterType = itk::FlipImageFilter<ItkImage>;
+  if(m_height == 0)
+    return;
+  mp_first_row += static_cast<std::ptrdiff_t>(m_height - 1) * m_row_stride; // shared buffers stay shared
+  m_row_stride = -m_row_stride;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TPixel>
+void
+Image<TPixel>::FlipVerticallyInPlace()
+  {
+  MakeUnique();
+  for(DimensionType y = 0; y < m_height / 2; ++y)
+    {
+    PixelType* p_row = GetUniqueRow(y);
+    std::swap_ranges(p_row, p_row + m_width, GetUniqueRow(m_height - 1 - y));
+    }
+  }
 
-  FlipImageFilterType::Pointer flipFilter = FlipImageFilterType::New();
-  flipFilter->SetInput(mp_image);
+//-----------------------------------------------------------------------------
+template<typename TPixel>
+void
+Image<TPixel>::MakeUnique()
+  {
+  if(mp_pixels.use_count() > 1)
+    _Detach(true);
+  }
 
-  FlipImageFilterType::FlipAxesArrayType flipAxes;
-  flipAxes[0] = false;
-  flipAxes[1] = true;
-  flipFilter->SetFlipAxes(flipAxes);
-  
-  flipFilter->Update();
+//-----------------------------------------------------------------------------
+template<typename TPixel>
+std::shared_ptr<TPixel>
+Image<TPixel>::_Allocate(std::size_t i_pixels_count)
+  {
+  if(i_pixels_count == 0)
+    return nullptr;
+  void* p_memory = ::operator new(i_pixels_count * sizeof(PixelType), std::align_val_t(Alignment));
+  return std::shared_ptr<PixelType>(static_cast<PixelType*>(p_memory), [](PixelType* ip_pixels)
+    {
+    ::operator delete(static_cast<void*>(ip_pixels), std::align_val_t(Alignment));
+    });
+  }
 
-  mp_image = flipFilter->GetOutput();
+//-----------------------------------------------------------------------------
+template<typename TPixel>
+void
+Image<TPixel>::_Detach(bool i_copy_pixels)
+  {
+  // Same layout, so the view stays where it was
+  std::size_t const pixels_count = static_cast<std::size_t>(std::abs(m_row_stride)) * m_height;
+  std::shared_ptr<PixelType> p_pixels = _Allocate(pixels_count);
+  if(i_copy_pixels)
+    std::memcpy(static_cast<void*>(p_pixels.get()), mp_pixels.get(), pixels_count * sizeof(PixelType));
+  mp_first_row = p_pixels.get() + (mp_first_row - mp_pixels.get());
+  mp_pixels = std::move(p_pixels);
   }
 
 
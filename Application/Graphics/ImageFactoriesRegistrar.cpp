@@ -1,4 +1,6 @@
 
+#if defined(ASR_WITH_ITK)
+
 #include <itkBMPImageIOFactory.h>
 #include <itkPNGImageIOFactory.h>
 #include <itkJPEGImageIOFactory.h>
@@ -24,3 +26,4 @@ struct ImageFactoriesRegistrar
 //-----------------------------------------------------------------------------
 static ImageFactoriesRegistrar s_registrar;
 
+#endif
@@ -0,0 +1,206 @@
+
+#pragma once
+
+#include "./Image.h"
+#include "./RGBPixel.h"
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+
+namespace Graphics {
+
+
+///////////////////////////////////////////////////////////////////////////////
+// PlanarImage // class declaration //
+///////////////////////////////////////////////////////////////////////////////
+// RGB image stored as structure of arrays: one aligned Image per component, so
+// a SIMD register loads the same component of several neighbouring pixels.
+// Planes are ordinary images, with their own copy on write and flip views;
+// the planar image only keeps them in step.
+template<typename TComponent>
+class PlanarImage
+  {
+  public:
+    using ComponentType = TComponent;
+    using PixelType = RGBPixel<ComponentType>;
+    using Plane = Image<ComponentType>;
+    static constexpr std::size_t PlanesCount = PixelType::Dimension;
+
+    PlanarImage();
+    PlanarImage(DimensionType i_x, DimensionType i_y, bool i_initialise = true);
+
+    // Go through an interleaved image, fail the same way as Image ones
+    bool Read(const char* i_filename);
+    bool Write(const char* i_filename) const;
+
+    PixelType Get(DimensionType i_x, DimensionType i_y) const;
+    void Set(DimensionType i_x, DimensionType i_y, PixelType const& i_c);
+
+    Plane& GetPlane(std::size_t i_component);
+    Plane const& GetPlane(std::size_t i_component) const;
+
+    DimensionType GetWidth() const;
+    DimensionType GetHeight() const;
+
+    void Fill(PixelType const& i_value);
+
+    void FlipVertically();
+    void FlipVerticallyInPlace();
+    void MakeUnique();
+
+  private:
+    std::array<Plane, PlanesCount> m_planes;
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// PlanarImage // class definition //
+///////////////////////////////////////////////////////////////////////////////
+template<typename TComponent>
+PlanarImage<TComponent>::PlanarImage()
+  : m_planes()
+  {
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TComponent>
+PlanarImage<TComponent>::PlanarImage(DimensionType i_x, DimensionType i_y, bool i_initialise)
+  {
+  for(auto& plane : m_planes)
+    plane = Plane(i_x, i_y, i_initialise);
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TComponent>
+bool
+PlanarImage<TComponent>::Read(const char* i_filename)
+  {
+  Image<PixelType> image;
+  if(!image.Read(i_filename))
+    return false;
+  PlanarImage planar_image(image.GetWidth(), image.GetHeight(), false);
+  for(DimensionType y = 0; y < image.GetHeight(); ++y)
+    {
+    PixelType const* p_pixels = image.GetRow(y);
+    for(std::size_t i = 0; i < PlanesCount; ++i)
+      {
+      ComponentType* p_components = planar_image.m_planes[i].GetRow(y);
+      for(DimensionType x = 0; x < image.GetWidth(); ++x)
+        p_components[x] = p_pixels[x][i];
+      }
+    }
+  *this = std::move(planar_image);
+  return true;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TComponent>
+bool
+PlanarImage<TComponent>::Write(const char* i_filename) const
+  {
+  Image<PixelType> image(GetWidth(), GetHeight(), false);
+  for(DimensionType y = 0; y < GetHeight(); ++y)
+    {
+    PixelType* p_pixels = image.GetRow(y);
+    for(std::size_t i = 0; i < PlanesCount; ++i)
+      {
+      ComponentType const* p_components = m_planes[i].GetRow(y);
+      for(DimensionType x = 0; x < GetWidth(); ++x)
+        p_pixels[x][i] = p_components[x];
+      }
+    }
+  return image.Write(i_filename);
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TComponent>
+typename PlanarImage<TComponent>::PixelType
+PlanarImage<TComponent>::Get(DimensionType i_x, DimensionType i_y) const
+  {
+  PixelType pixel;
+  for(std::size_t i = 0; i < PlanesCount; ++i)
+    pixel[i] = m_planes[i].Get(i_x, i_y);
+  return pixel;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TComponent>
+void
+PlanarImage<TComponent>::Set(DimensionType i_x, DimensionType i_y, PixelType const& i_c)
+  {
+  for(std::size_t i = 0; i < PlanesCount; ++i)
+    m_planes[i].Set(i_x, i_y, i_c[i]);
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TComponent>
+typename PlanarImage<TComponent>::Plane&
+PlanarImage<TComponent>::GetPlane(std::size_t i_component)
+  {
+  return m_planes[i_component];
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TComponent>
+typename PlanarImage<TComponent>::Plane const&
+PlanarImage<TComponent>::GetPlane(std::size_t i_component) const
+  {
+  return m_planes[i_component];
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TComponent>
+DimensionType
+PlanarImage<TComponent>::GetWidth() const
+  {
+  return m_planes[0].GetWidth();
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TComponent>
+DimensionType
+PlanarImage<TComponent>::GetHeight() const
+  {
+  return m_planes[0].GetHeight();
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TComponent>
+void
+PlanarImage<TComponent>::Fill(PixelType const& i_value)
+  {
+  for(std::size_t i = 0; i < PlanesCount; ++i)
+    m_planes[i].Fill(i_value[i]);
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TComponent>
+void
+PlanarImage<TComponent>::FlipVertically()
+  {
+  for(auto& plane : m_planes)
+    plane.FlipVertically();
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TComponent>
+void
+PlanarImage<TComponent>::FlipVerticallyInPlace()
+  {
+  for(auto& plane : m_planes)
+    plane.FlipVerticallyInPlace();
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TComponent>
+void
+PlanarImage<TComponent>::MakeUnique()
+  {
+  for(auto& plane : m_planes)
+    plane.MakeUnique();
+  }
+
+
+} // namespace Graphics
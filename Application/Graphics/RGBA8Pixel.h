@@ -0,0 +1,119 @@
+
+#pragma once
+
+#include "./RGBPixel.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+namespace Graphics {
+
+
+///////////////////////////////////////////////////////////////////////////////
+// RGBA8Pixel // struct declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Four 8-bit components aligned as one 32-bit word, so a pixel is read and
+// written with a single load or store and 4 of them fill an SSE register.
+// Memory order is R, G, B, A as in itk::RGBAPixel<unsigned char>; the packed
+// word is that memory read as a native uint32 (0xAABBGGRR on little endian).
+struct alignas(sizeof(std::uint32_t)) RGBA8Pixel
+  {
+  using ComponentType = unsigned char;
+  using RGBType = RGBPixel<ComponentType>;
+  static constexpr std::size_t Dimension = 4;
+  static constexpr ComponentType Opaque = 255;
+
+  ComponentType m_components[Dimension];
+
+  ComponentType& operator[](std::size_t i_idx);
+  ComponentType const& operator[](std::size_t i_idx) const;
+
+  void Fill(ComponentType i_value);
+
+  std::uint32_t GetPacked() const;
+  static RGBA8Pixel FromPacked(std::uint32_t i_packed);
+
+  RGBType ToRGB() const;
+  static RGBA8Pixel FromRGB(RGBType const& i_rgb, ComponentType i_alpha = Opaque);
+
+  bool operator==(RGBA8Pixel const& i_other) const;
+  bool operator!=(RGBA8Pixel const& i_other) const;
+  };
+
+static_assert(sizeof(RGBA8Pixel) == sizeof(std::uint32_t), "RGBA8Pixel is expected to be packed in 32 bits");
+
+
+///////////////////////////////////////////////////////////////////////////////
+// RGBA8Pixel // struct definition //
+///////////////////////////////////////////////////////////////////////////////
+inline RGBA8Pixel::ComponentType&
+RGBA8Pixel::operator[](std::size_t i_idx)
+  {
+  return m_components[i_idx];
+  }
+
+//-----------------------------------------------------------------------------
+inline RGBA8Pixel::ComponentType const&
+RGBA8Pixel::operator[](std::size_t i_idx) const
+  {
+  return m_components[i_idx];
+  }
+
+//-----------------------------------------------------------------------------
+inline void
+RGBA8Pixel::Fill(ComponentType i_value)
+  {
+  for(std::size_t i = 0; i < Dimension; ++i)
+    m_components[i] = i_value;
+  }
+
+//-----------------------------------------------------------------------------
+inline std::uint32_t
+RGBA8Pixel::GetPacked() const
+  {
+  std::uint32_t packed;
+  std::memcpy(&packed, m_components, sizeof(packed));
+  return packed;
+  }
+
+//-----------------------------------------------------------------------------
+inline RGBA8Pixel
+RGBA8Pixel::FromPacked(std::uint32_t i_packed)
+  {
+  RGBA8Pixel pixel;
+  std::memcpy(pixel.m_components, &i_packed, sizeof(i_packed));
+  return pixel;
+  }
+
+//-----------------------------------------------------------------------------
+inline RGBA8Pixel::RGBType
+RGBA8Pixel::ToRGB() const
+  {
+  return RGBType{{m_components[0], m_components[1], m_components[2]}};
+  }
+
+//-----------------------------------------------------------------------------
+inline RGBA8Pixel
+RGBA8Pixel::FromRGB(RGBType const& i_rgb, ComponentType i_alpha)
+  {
+  return RGBA8Pixel{{i_rgb[0], i_rgb[1], i_rgb[2], i_alpha}};
+  }
+
+//-----------------------------------------------------------------------------
+inline bool
+RGBA8Pixel::operator==(RGBA8Pixel const& i_other) const
+  {
+  return GetPacked() == i_other.GetPacked();
+  }
+
+//-----------------------------------------------------------------------------
+inline bool
+RGBA8Pixel::operator!=(RGBA8Pixel const& i_other) const
+  {
+  return !(*this == i_other);
+  }
+
+
+} // namespace Graphics
@@ -0,0 +1,80 @@
+
+#pragma once
+
+#include <cstddef>
+
+
+namespace Graphics {
+
+
+///////////////////////////////////////////////////////////////////////////////
+// RGBPixel // struct declaration //
+///////////////////////////////////////////////////////////////////////////////
+// Three interleaved color components, laid out exactly as itk::RGBPixel, so
+// images convert to and from ITK ones by plain copies. Trivially copyable.
+template<typename TComponent>
+struct RGBPixel
+  {
+  using ComponentType = TComponent;
+  static constexpr std::size_t Dimension = 3;
+
+  TComponent m_components[Dimension];
+
+  TComponent& operator[](std::size_t i_idx);
+  TComponent const& operator[](std::size_t i_idx) const;
+
+  void Fill(TComponent const& i_value);
+
+  bool operator==(RGBPixel const& i_other) const;
+  bool operator!=(RGBPixel const& i_other) const;
+  };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// RGBPixel // struct definition //
+///////////////////////////////////////////////////////////////////////////////
+template<typename TComponent>
+TComponent&
+RGBPixel<TComponent>::operator[](std::size_t i_idx)
+  {
+  return m_components[i_idx];
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TComponent>
+TComponent const&
+RGBPixel<TComponent>::operator[](std::size_t i_idx) const
+  {
+  return m_components[i_idx];
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TComponent>
+void
+RGBPixel<TComponent>::Fill(TComponent const& i_value)
+  {
+  for(std::size_t i = 0; i < Dimension; ++i)
+    m_components[i] = i_value;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TComponent>
+bool
+RGBPixel<TComponent>::operator==(RGBPixel const& i_other) const
+  {
+  for(std::size_t i = 0; i < Dimension; ++i)
+    if(m_components[i] != i_other.m_components[i])
+      return false;
+  return true;
+  }
+
+//-----------------------------------------------------------------------------
+template<typename TComponent>
+bool
+RGBPixel<TComponent>::operator!=(RGBPixel const& i_other) const
+  {
+  return !(*this == i_other);
+  }
+
+
+} // namespace Graphics